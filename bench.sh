@@ -0,0 +1,85 @@
+#!/bin/bash
+# Benchmark floorplan on resources/test0-3. A build with SEARCH_STAT and
+# ALLOC_STAT logs statistics of every pattern, they are summed per test.
+#
+# usage: ./bench.sh [options of EDA_CHALLENGE_Q4.out]
+#   BIN=path ./bench.sh  runs a binary built elsewhere, like an older commit
+#   RUNS=n ./bench.sh    averages n runs of every test, 1 by default
+#   COPIES=n ./bench.sh  constraints of test0 in the parse file, 2000 by default
+#
+# pairs         pairs of child picks merged
+# picks/pair    picks allocated per pair, each was a malloc before pools
+# mallocs/pair  mallocs of pools per pair
+# heap/pair     all heap allocations of traversals per pair, like copies of
+#               containers returned by value
+# checks        cell-conflict checks between picks
+# traverse ms   time of pattern tree traversals
+#
+# Parse throughput is measured last, on a constraint file that repeats the
+# constraints of test0, since the test files are too small to time.
+
+ROOT=$(cd "$(dirname "$0")" && pwd)
+RUNS=${RUNS:-1}
+COPIES=${COPIES:-2000}
+BUILD_DIR=$ROOT/build_bench
+if [ -z "$BIN" ]; then
+  BIN=$BUILD_DIR/EDA_CHALLENGE_Q4.out
+  cmake -S "$ROOT" -B "$BUILD_DIR" -Dstat=1 > /dev/null || exit 1
+  cmake --build "$BUILD_DIR" -j > /dev/null 2>&1 || exit 1
+fi
+
+printf "%-6s %4s %9s %11s %14s %10s %9s %12s\n" test exit pairs picks/pair \
+  mallocs/pair heap/pair checks "traverse ms"
+for t in 0 1 2 3; do
+  case_dir=$ROOT/resources/test$t
+  run_dir=$BUILD_DIR/run/test$t
+  rm -rf "$run_dir"
+  mkdir -p "$run_dir/build" "$run_dir/output"
+  # log.txt goes to ../output, runs append to it
+  for ((run = 0; run < RUNS; ++run)); do
+    (cd "$run_dir/build" &&
+     "$BIN" -f"$case_dir/configure.xml" -s"$case_dir/constraint.xml" "$@" \
+       > /dev/null 2>&1) 2> /dev/null
+    rc=$?
+  done
+
+  awk -v name=test$t -v rc=$rc -v runs=$RUNS '
+    function field(line, key) {
+      if (!match(line, key " = [0-9.]+")) return 0
+      return substr(line, RSTART + length(key) + 3) + 0
+    }
+    /^\[alloc\]/ {
+      pairs += field($0, "pairs")
+      picks += field($0, "picks")
+      mallocs += field($0, "pool mallocs")
+      heap += field($0, "heap")
+    }
+    /^\[traverse\]/ {
+      checks += field($0, "repeat checks")
+      ms += field($0, "time")
+    }
+    END {
+      per = pairs ? 1 / pairs : 0
+      printf "%-6s %4d %9d %11.3f %14.5f %10.3f %9d %12.3f\n", name, rc,
+             pairs / runs, picks * per, mallocs * per, heap * per,
+             checks / runs, ms / runs
+    }' "$run_dir/output/log.txt"
+done
+
+case_dir=$ROOT/resources/test0
+run_dir=$BUILD_DIR/run/parse
+rm -rf "$run_dir"
+mkdir -p "$run_dir/build" "$run_dir/output"
+awk -v copies=$COPIES '
+  /<CONSTRAINT>/ { inside = 1 }
+  inside { block = block $0 "\n" }
+  !inside && !block { print }
+  /<\/CONSTRAINT>/ { inside = 0 }
+  END {
+    for (i = 0; i < copies; ++i) printf "%s", block
+    print "</data>"
+  }' "$case_dir/constraint.xml" > "$run_dir/constraint.xml"
+(cd "$run_dir/build" &&
+ "$BIN" -f"$case_dir/configure.xml" -s"$run_dir/constraint.xml" "$@" \
+   > /dev/null 2>&1) 2> /dev/null
+awk '/^\[parse\]/ { print "parse: " substr($0, 9) }' "$run_dir/output/log.txt"
@@ -0,0 +1,74 @@
+#ifndef __BOUNDED_QUEUE_HPP_
+#define __BOUNDED_QUEUE_HPP_
+
+#include <stddef.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+
+namespace EDA_CHALLENGE_Q4 {
+
+/**
+ * @brief FIFO between threads holding at most capacity items. Producers wait
+ * while it is full, consumers wait while it is empty, until it is closed.
+ */
+template <typename T>
+class BoundedQueue {
+ public:
+  // constructor
+  explicit BoundedQueue(size_t);
+  BoundedQueue(const BoundedQueue&) = delete;
+  ~BoundedQueue() = default;
+
+  // function
+  void push(T);
+  bool pop(T&);
+  void close();
+
+ private:
+  // members
+  std::mutex _mutex;
+  std::condition_variable _not_full;
+  std::condition_variable _not_empty;
+  std::queue<T> _items;
+  size_t _capacity;
+  bool _closed;  // no more push
+};
+
+template <typename T>
+inline BoundedQueue<T>::BoundedQueue(size_t capacity)
+    : _capacity(capacity ? capacity : 1), _closed(false) {}
+
+template <typename T>
+inline void BoundedQueue<T>::push(T item) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _not_full.wait(lock, [this] { return _items.size() < _capacity; });
+  _items.push(std::move(item));
+  _not_empty.notify_one();
+}
+
+/**
+ * @return false if the queue is closed and nothing is left
+ */
+template <typename T>
+inline bool BoundedQueue<T>::pop(T& item /*out*/) {
+  std::unique_lock<std::mutex> lock(_mutex);
+  _not_empty.wait(lock, [this] { return _closed || !_items.empty(); });
+  if (_items.empty()) return false;
+
+  item = std::move(_items.front());
+  _items.pop();
+  _not_full.notify_one();
+  return true;
+}
+
+template <typename T>
+inline void BoundedQueue<T>::close() {
+  std::lock_guard<std::mutex> lock(_mutex);
+  _closed = true;
+  _not_empty.notify_all();
+}
+
+}  // namespace EDA_CHALLENGE_Q4
+#endif
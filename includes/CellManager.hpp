@@ -11,6 +11,8 @@
 
 namespace EDA_CHALLENGE_Q4 {
 
+const static int id_deviate = 1000;  // cell_id = refer_id * id_deviate + i
+
 enum CellPriority {
   kPrioMem,
   kPrioSoc,
@@ -38,7 +40,7 @@ class Cell {
   auto get_min_edge() const { return _height < _width ? _height : _width; }
   auto get_ratioWH() const { return 1.0 * _width / _height; }
   float get_ratioWH_max();
-  auto get_refer() const { return _refer; }
+  const std::string& get_refer() const { return _refer; }
   int get_area() const { return _width * _height; }
   auto get_x() const { return _c1._x; }
   auto get_y() const { return _c1._y; }
@@ -48,6 +50,8 @@ class Cell {
   float get_flex_x() const;
   float get_flex_y() const;
   auto get_cell_id() const { return _cell_id; }
+  auto get_index() const { return _index; }
+  auto get_class() const { return _class; }
   int get_refer_id();
   Rectangle get_box();
   CellType get_cell_type();
@@ -64,6 +68,8 @@ class Cell {
   void set_x_range(Point range) { _x_range = range; }
   void set_y_range(Point range) { _y_range = range; }
   void set_cell_id(int cell_id) { _cell_id = cell_id; }
+  void set_index(int index) { _index = index; }
+  void set_class(int cell_class) { _class = cell_class; }
 
   // function
   void rotate();
@@ -80,6 +86,16 @@ class Cell {
   Point _x_range;   // if c1 in this range, then x meets constraint
   Point _y_range;   // if c1 in this range, then y meets constraint
   int _cell_id;
+  int _index;  // dense index in CellManager, from 0
+  int _class;  // dense index of refer in CellManager, cells of one class
+               // are interchangeable
+};
+
+// shape of a cell without rotation, never changes after initialization
+struct CellShape {
+  uint16_t _width;
+  uint16_t _height;
+  CellType _type;
 };
 
 class CellManager {
@@ -90,22 +106,28 @@ class CellManager {
   ~CellManager();
 
   // sjc add.
-  std::map<int, Cell*> get_cells() const { return _id_map; }
+  const std::vector<Cell*>& get_cells() const { return _cells; }
 
   // getter
-  auto get_mems() const { return _mems; }
+  const std::vector<Cell*>& get_mems() const { return _mems; }
   auto get_mems_num() const { return _mems.size(); }
-  auto get_socs() const { return _socs; }
+  const std::vector<Cell*>& get_socs() const { return _socs; }
   auto get_socs_num() const { return _socs.size(); }
   Cell* get_cell(int);
-  auto get_id_map_num() const { return _id_map.size(); }
+  Cell* get_cell_by_index(int index) const { return _cells[index]; }
+  const CellShape& get_shape(int index) const { return _shapes[index]; }
+  auto get_cells_num() const { return _cells.size(); }
+  auto get_classes_num() const { return _class_first.size(); }
+  auto get_class_amount(int c) const { return _class_amount[c]; }
+  Cell* get_class_cell(int, int) const;
 
   // setter
 
   // function
   void insert_cell(CellType, Cell*);
   std::vector<Cell*> choose_cells(bool, CellPriority, ...);
-  std::vector<Cell*> choose_cells(CellType);
+  const std::vector<Cell*>& choose_cells(CellType) const;
+  const std::vector<Cell*>& choose_class_cells(CellType) const;
   void delete_cell(CellType, Cell*);
   std::vector<Cell*> retrieve();
   int cal_cell_area(const std::vector<int>&);
@@ -116,7 +138,7 @@ class CellManager {
   std::vector<Cell*> get_min_area_sorted_chose_cells(std::map<Cell*, int>&);
 
   // function
-  void init_cells(CellType, std::vector<Config*>);
+  void init_cells(CellType, const std::vector<Config*>&);
   std::vector<Cell*> choose_range(bool, CellType, uint16_t, uint16_t, uint16_t,
                                   uint16_t);
   std::vector<Cell*> choose_ratioWH_max(bool, CellType);
@@ -127,13 +149,20 @@ class CellManager {
   static bool cmp_ratioWH_max(Cell* a, Cell* b);
   void init_mems_aux();
   void init_socs_aux();
+  void init_classes();
 
   // members
   std::vector<Cell*> _mems;
   std::vector<Cell*> _socs;
   std::vector<Cell*> _mems_aux;  // to record, please not to change members
   std::vector<Cell*> _socs_aux;
-  std::map<int, Cell*> _id_map;
+  std::vector<Cell*> _cells;        // all cells, indexed by Cell::_index
+  std::vector<CellShape> _shapes;  // indexed by Cell::_index as _cells
+  std::vector<int> _refer_offset;  // refer_id -> index of its first cell
+  std::vector<int> _class_first;   // class -> index of its first cell
+  std::vector<uint16_t> _class_amount;  // class -> number of its cells
+  std::vector<Cell*> _mem_classes;     // first cell of every mem class
+  std::vector<Cell*> _soc_classes;
 };
 
 // Cell
@@ -145,6 +174,8 @@ inline Cell::Cell(const Cell& c) {
   _refer = c.get_refer();
   _vcg_id = c.get_vcg_id();
   _cell_id = c.get_cell_id();
+  _index = c.get_index();
+  _class = c.get_class();
 }
 
 /* rotate the cell and exchange width with height*/
@@ -180,7 +211,24 @@ inline void CellManager::insert_cell(CellType type, Cell* cell) {
   auto list = get_list(false, type);
   if (list) {
     list->push_back(cell);
-    _id_map[cell->get_cell_id()] = cell;
+
+    // new cell gets the next index, returned cell keeps its own
+    auto index = cell->get_index();
+    if (index == (int)_cells.size()) {
+      _cells.push_back(cell);
+      auto rotation = cell->get_rotation();
+      _shapes.push_back({rotation ? cell->get_height() : cell->get_width(),
+                         rotation ? cell->get_width() : cell->get_height(),
+                         cell->get_cell_type()});
+      auto refer_id = cell->get_refer_id();
+      if (refer_id >= (int)_refer_offset.size()) {
+        _refer_offset.resize(refer_id + 1, -1);
+      }
+      if (_refer_offset[refer_id] < 0) {
+        _refer_offset[refer_id] = index;
+      }
+    }
+    ASSERT(_cells[index] == cell, "Cell index = %d conflict", index);
   }
 }
 
@@ -221,8 +269,19 @@ inline bool CellManager::cmp_ratioWH_max(Cell* a, Cell* b) {
   }
 }
 
+/* cells of one refer have consecutive indexes, so cell_id maps in O(1) */
 inline Cell* CellManager::get_cell(int cell_id) {
-  return _id_map.count(cell_id) ? _id_map[cell_id] : nullptr;
+  auto refer_id = cell_id / id_deviate;
+  if (cell_id < 0 || refer_id >= (int)_refer_offset.size() ||
+      _refer_offset[refer_id] < 0) {
+    return nullptr;
+  }
+
+  size_t index = _refer_offset[refer_id] + cell_id % id_deviate;
+  if (index < _cells.size() && _cells[index]->get_cell_id() == cell_id) {
+    return _cells[index];
+  }
+  return nullptr;
 }
 
 inline void CellManager::init_mems_aux() {
@@ -240,15 +299,37 @@ inline void CellManager::init_socs_aux() {
 inline int CellManager::cal_cell_area(const std::vector<int>& cell_ids) {
   int area = 0;
   for (auto id : cell_ids) {
-    ASSERT(_id_map.count(id), "Can not find cell whose id = %d", id);
+    auto cell = get_cell(id);
+    ASSERT(cell, "Can not find cell whose id = %d", id);
 
-    auto cell = _id_map[id];
     area += cell->get_area();
   }
   return area;
 }
 
-inline std::vector<Cell*> CellManager::choose_cells(CellType c_type) {
+/* i-th cell of class, cells of one class have consecutive indexes */
+inline Cell* CellManager::get_class_cell(int c, int i) const {
+  ASSERT(i < _class_amount[c], "Class = %d has only %d cells", c,
+         _class_amount[c]);
+  return _cells[_class_first[c] + i];
+}
+
+/* one cell for every class, standing for all cells of its class */
+inline const std::vector<Cell*>& CellManager::choose_class_cells(
+    CellType c_type) const {
+  switch (c_type) {
+    case kCellTypeSoc:
+      return _soc_classes;
+    case kCellTypeMem:
+      return _mem_classes;
+    default:
+      PANIC("Invalid celltype = %d", c_type);
+      return _mem_classes;
+  }
+}
+
+inline const std::vector<Cell*>& CellManager::choose_cells(
+    CellType c_type) const {
   switch (c_type) {
     case kCellTypeSoc:
       return _socs_aux;
@@ -256,6 +337,7 @@ inline std::vector<Cell*> CellManager::choose_cells(CellType c_type) {
       return _mems_aux;
     default:
       PANIC("Invalid celltype = %d", c_type);
+      return _mems_aux;
   }
 }
 
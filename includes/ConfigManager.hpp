@@ -3,6 +3,7 @@
 
 #include <map>
 #include <string>
+#include <string_view>
 
 #include "Regex.hpp"
 
@@ -23,7 +24,7 @@ class Config {
   auto get_amount() const { return _amount; }
   auto get_width() const { return _width; }
   auto get_height() const { return _height; }
-  auto get_refer() const { return _refer; }
+  const std::string& get_refer() const { return _refer; }
 
   // setter
   void set_id_refer(const uint8_t id_refer) { _id_refer = id_refer; }
@@ -31,7 +32,7 @@ class Config {
   void set_width(const uint16_t width) { _width = width; }
   void set_height(const uint16_t height) { _height = height; }
   void set_value(RegexType, uint16_t);
-  void set_refer(const std::string refer) { _refer = refer; }
+  void set_refer(std::string_view refer) { _refer = refer; }
 
   // function
 
@@ -44,24 +45,36 @@ class Config {
   std::string _refer;
 };
 
-class ConfigManager {
+/**
+ * @brief Configs of cells, filled by tokens of configure.xml as it is scanned
+ */
+class ConfigManager : public TokenHandler {
  public:
   // constructor
-  ConfigManager(Token_List&);
+  ConfigManager();
   ~ConfigManager();
 
   // getter
-  auto get_mem_list() const { return _mem_config_list; }
-  auto get_soc_list() const { return _soc_config_list; }
+  const std::vector<Config*>& get_mem_list() const { return _mem_config_list; }
+  const std::vector<Config*>& get_soc_list() const { return _soc_config_list; }
 
   // setter
 
   // function
+  void add_config(CellType, Config*);
+  void on_token(RegexType, std::string_view) override;
+  void on_end() override;
 
  private:
   std::map<uint8_t, std::string> _id_refers_map;  // to store Reference as key
   std::vector<Config*> _mem_config_list;
   std::vector<Config*> _soc_config_list;
+
+  // parsing state
+  std::vector<RegexType> _stack;  // open tags
+  std::vector<Config*>* _op_list;
+  Config* _conf;
+  uint8_t _id_base;
 };
 
 // Config
@@ -91,6 +104,17 @@ inline void Config::set_value(RegexType type, uint16_t data) {
 }
 
 // ConfigManager
+inline ConfigManager::ConfigManager()
+    : _op_list(nullptr), _conf(nullptr), _id_base(0) {}
+
+/* config built elsewhere, like a cache, ConfigManager owns it then */
+inline void ConfigManager::add_config(CellType type, Config* conf) {
+  ASSERT(type == kCellTypeMem || type == kCellTypeSoc, "Invalid celltype = %d",
+         type);
+  auto& list = type == kCellTypeMem ? _mem_config_list : _soc_config_list;
+  list.push_back(conf);
+  _id_refers_map[conf->get_id_refer()] = conf->get_refer();
+}
 
 }  // namespace EDA_CHALLENGE_Q4
 
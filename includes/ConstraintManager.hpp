@@ -3,7 +3,9 @@
 
 #include <stdint.h>
 
+#include <functional>
 #include <map>
+#include <string_view>
 #include <utility>
 
 #include "Debug.h"
@@ -46,12 +48,14 @@ class Constraint {
 
   // getter
   auto get_cst(ConstraintType) const;
-  auto get_pattern() { return _pattern; }
+  const std::string& get_pattern() const { return _pattern; }
+  auto get_beam_width() const { return _beam_width; }
 
   // setter
   void set_constraint(ConstraintType, uint16_t);
-  void set_constraint(RegexType, const char*);
-  void set_pattern(std::string pattern) { _pattern = pattern; }
+  void set_constraint(RegexType, std::string_view);
+  void set_pattern(std::string_view pattern) { _pattern = pattern; }
+  void set_beam_width(uint16_t width) { _beam_width = width; }
 
   // function
 
@@ -59,23 +63,40 @@ class Constraint {
   // members
   std::string _pattern;
   uint16_t _constraint[kTotal];
+  uint16_t _beam_width = 0;  // optional <BEAM_WIDTH>, 0 if not given
 };
 
-class ConstraintManager {
+/**
+ * @brief Constraints of patterns, filled by tokens of constraint.xml as it is
+ * scanned
+ */
+class ConstraintManager : public TokenHandler {
  public:
   // constructor
-  ConstraintManager(Token_List&);
+  ConstraintManager() : _constraint(nullptr) {}
   ~ConstraintManager();
 
   // getter
-  auto get_pattern_list() const { return _pattern_list; }
+  const std::vector<Constraint*>& get_pattern_list() const {
+    return _pattern_list;
+  }
 
   // setter
+  void set_sink(std::function<void(Constraint*)> sink) { _sink = sink; }
 
   // function
+  void add_constraint(Constraint* c) { _pattern_list.push_back(c); }
+  void on_token(RegexType, std::string_view) override;
+  void on_end() override;
 
  private:
   std::vector<Constraint*> _pattern_list;
+  // takes every parsed constraint instead of _pattern_list if set, and owns it
+  std::function<void(Constraint*)> _sink;
+
+  // parsing state
+  std::vector<RegexType> _stack;  // open tags
+  Constraint* _constraint;
 };
 
 // Constraint
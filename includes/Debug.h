@@ -31,9 +31,21 @@ namespace EDA_CHALLENGE_Q4 {
 
 #define G_LOG
 
-extern std::fstream g_log;
+// log [prune], [traverse] and [alloc] statistics of every pattern
+// #define SEARCH_STAT
+
+// count heap allocations of every thread in g_alloc_num
+// #define ALLOC_STAT
+
+// every thread owns its log stream, see log_redirect()
+extern thread_local std::fstream g_log;
 void log_init();
 void log_close();
+std::streambuf* log_redirect(std::streambuf*);
+
+#ifdef ALLOC_STAT
+extern thread_local size_t g_alloc_num;
+#endif
 
 }  // namespace EDA_CHALLENGE_Q4
 #endif
\ No newline at end of file
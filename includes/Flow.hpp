@@ -11,9 +11,12 @@
 #define __FLOW_HPP_
 
 #include "../legalization/CellMovement.h"
+#include "../legalization/DifferenceConstraintLegalizer.h"
 #include "CellManager.hpp"
 #include "ConfigManager.hpp"
 #include "ConstraintManager.hpp"
+#include "ProblemCache.hpp"
+#include "VCG.hpp"
 
 namespace EDA_CHALLENGE_Q4 {
 
@@ -54,7 +57,11 @@ class Flow {
   void doTaskParseArgv();
   void doTaskParseResources();
   void doTaskFloorplan();
-  void parseXml(char*);
+  size_t parseProblem();
+  size_t parseXml(char*);
+  void floorplan(Regex*, Constraint*, size_t, std::ostream&);
+  void floorplan_parallel(std::ostream&);
+  void floorplan_stream(std::ostream&);
 
   // member
   FlowStepType _step;      // flow step
@@ -62,6 +69,11 @@ class Flow {
   char** _argv;            // argv of main function
   char* _config_file;      // configure.xml
   char* _constraint_file;  // constraint.xml
+  int _jobs;               // patterns floorplanned at the same time
+  bool _legalize;          // solve spacing exactly after floorplan
+  int _stream;  // capacity of parsed pattern queue, 0 to parse all first
+  char* _cache_file;  // binary snapshot of both xml files, nullptr if none
+  SearchConfig _search_config;  // of all patterns, may be changed per pattern
   Regex* _parser;
   ConfigManager* _conf_man;
   ConstraintManager* _constraint_man;
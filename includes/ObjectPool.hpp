@@ -0,0 +1,128 @@
+#ifndef __OBJECT_POOL_HPP_
+#define __OBJECT_POOL_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "Debug.h"
+
+namespace EDA_CHALLENGE_Q4 {
+
+/**
+ * @brief Pool of fixed-size blocks. Blocks are carved from big chunks and
+ * recycled through a free list, chunks are released together with the pool.
+ * Every block remembers its owner, so it can be freed without knowing which
+ * pool is in use. Blocks requested without a pool fall back to malloc.
+ */
+class ObjectPool {
+ public:
+  // constructor
+  ObjectPool(size_t);
+  ObjectPool(const ObjectPool&) = delete;
+  ~ObjectPool();
+
+  // getter
+  auto get_alloc_num() const { return _alloc_num; }
+  auto get_chunk_num() const { return _chunks.size(); }
+
+  // setter
+  void set_size(size_t);
+
+  // function
+  static void* alloc(ObjectPool*, size_t);
+  static void free(void*);
+
+ private:
+  struct Block {
+    ObjectPool* owner;  // nullptr if block is from malloc
+    Block* next;        // only valid in free list, the rest is user data
+  };
+
+  // function
+  void* alloc();
+  void release(Block*);
+  void grow();
+
+  // members
+  static constexpr size_t _head = alignof(max_align_t);  // space for owner
+  static constexpr size_t _chunk_blocks = 256;
+  size_t _stride;  // bytes of one block, including head
+  Block* _free;
+  std::vector<char*> _chunks;
+  size_t _alloc_num;  // blocks handed out in total
+};
+
+inline ObjectPool::ObjectPool(size_t size)
+    : _free(nullptr), _alloc_num(0) {
+  static_assert(sizeof(Block) <= _head, "Block head overflow");
+  set_size(size);
+}
+
+/* block size can only change before the first block is handed out */
+inline void ObjectPool::set_size(size_t size) {
+  ASSERT(_chunks.empty(), "Resize pool in use");
+  _stride = _head + (size + _head - 1) / _head * _head;
+}
+
+inline ObjectPool::~ObjectPool() {
+  for (auto chunk : _chunks) {
+    ::free(chunk);
+  }
+  _chunks.clear();
+  _free = nullptr;
+}
+
+inline void* ObjectPool::alloc(ObjectPool* pool, size_t size) {
+  if (pool) {
+    ASSERT(size + _head <= pool->_stride, "Block too small for %zu bytes",
+           size);
+    return pool->alloc();
+  }
+
+  auto block = (Block*)malloc(_head + size);
+  ASSERT(block, "Out of memory");
+  block->owner = nullptr;
+  return (char*)block + _head;
+}
+
+inline void ObjectPool::free(void* p) {
+  if (p == nullptr) return;
+
+  auto block = (Block*)((char*)p - _head);
+  if (block->owner) {
+    block->owner->release(block);
+  } else {
+    ::free(block);
+  }
+}
+
+inline void* ObjectPool::alloc() {
+  if (_free == nullptr) {
+    grow();
+  }
+  auto block = _free;
+  _free = block->next;
+  block->owner = this;
+  ++_alloc_num;
+  return (char*)block + _head;
+}
+
+inline void ObjectPool::release(Block* block) {
+  block->next = _free;
+  _free = block;
+}
+
+inline void ObjectPool::grow() {
+  auto chunk = (char*)malloc(_stride * _chunk_blocks);
+  ASSERT(chunk, "Out of memory");
+  _chunks.push_back(chunk);
+  for (size_t i = _chunk_blocks; i > 0; --i) {
+    release((Block*)(chunk + (i - 1) * _stride));
+  }
+}
+
+}  // namespace EDA_CHALLENGE_Q4
+#endif
@@ -0,0 +1,49 @@
+#ifndef __PROBLEM_CACHE_HPP_
+#define __PROBLEM_CACHE_HPP_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "ConfigManager.hpp"
+#include "ConstraintManager.hpp"
+
+namespace EDA_CHALLENGE_Q4 {
+
+/**
+ * @brief Binary snapshot of configure.xml and constraint.xml. It starts with
+ * a magic, a format version and a hash of both xml files, so a stale or
+ * foreign file is never loaded. The rest is the configs and constraints in
+ * native byte order:
+ *
+ *   header    magic[8] version:u32 reserved:u32 hash:u64
+ *             mem_num:u32 soc_num:u32 constraint_num:u32
+ *   config    id_refer:u8 amount:u16 width:u16 height:u16 refer_len:u16
+ *             refer[refer_len]
+ *   constraint  beam_width:u16 constraint[kTotal]:u16 pattern_len:u32
+ *               pattern[pattern_len]
+ */
+class ProblemCache {
+ public:
+  // constructor
+  ProblemCache(const char* path) : _path(path) {}
+  ~ProblemCache() = default;
+
+  // function
+  static uint64_t hash_inputs(const char*, const char*);
+  bool load(uint64_t, ConfigManager*, ConstraintManager*);
+  bool save(uint64_t, const ConfigManager*, const ConstraintManager*) const;
+
+ private:
+  // function
+  static uint64_t hash_file(const char*, uint64_t);
+
+  // members
+  static constexpr char _magic[8] = {'E', 'D', 'A', 'Q', '4', 'P', 'C', 0};
+  static constexpr uint32_t _version = 1;
+  std::string _path;
+};
+
+}  // namespace EDA_CHALLENGE_Q4
+#endif
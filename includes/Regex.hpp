@@ -1,11 +1,13 @@
 #ifndef __REGEX_HPP_
 #define __REGEX_HPP_
 
-#include <regex.h>
+#include <ctype.h>
 #include <string.h>
-#include <sys/types.h>
 
+#include <charconv>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "Debug.h"
 
@@ -49,6 +51,7 @@ enum RegexType {
   kTAG_YMI_BEG,
   kTAG_XSI_BEG,
   kTAG_YSI_BEG,
+  kTAG_BEAM_BEG,
   kTAG_CONSTRAINT_END,
   kTAG_PATTERN_END,
   kTAG_XMM_END,
@@ -61,6 +64,7 @@ enum RegexType {
   kTAG_YMI_END,
   kTAG_XSI_END,
   kTAG_YSI_END,
+  kTAG_BEAM_END,
   // constraint tag end //
 
   kDATA,
@@ -81,68 +85,43 @@ enum RegexType {
 
 typedef std::vector<std::pair<std::string, RegexType>> Token_List;
 
-/* We use the POSIX regex functions to process regular expressions.*/
-static struct RegexRule {
-  std::string regex;
-  RegexType token_type;
-} xml_rules[] =
-    {
-        {" +", kSPACE},
-        // xml head
-        {"<\\?[a-z0-9 =\".]+\\?>", kTAG_XML_HEAD},
-        {"<data>", kTAG_DATA_BEG},
-        {"</data>", kTAG_DATA_END},
-        // config tag beg
-        {"<MEM>", kTAG_MEM_BEG},
-        {"<SOC>", kTAG_SOC_BEG},
-        {"<REFERENCE>", kTAG_REFERENCE_BEG},
-        {"<AMOUNT>", kTAG_AMOUNT_BEG},
-        {"<WIDTH>", kTAG_WIDTH_BEG},
-        {"<HEIGHT>", kTAG_HEIGHT_BEG},
-        {"</REFERENCE>", kTAG_REFERENCE_END},
-        {"</AMOUNT>", kTAG_AMOUNT_END},
-        {"</WIDTH>", kTAG_WIDTH_END},
-        {"</HEIGHT>", kTAG_HEIGHT_END},
-        {"</SOC>", kTAG_SOC_END},
-        {"</MEM>", kTAG_MEM_END},
-        // config tag end
-        // constraint tag beg
-        {"<CONSTRAINT>", kTAG_CONSTRAINT_BEG},
-        {"<PATTERN>", kTAG_PATTERN_BEG},
-        {"<SPACING_X_MEM_MEM>", kTAG_XMM_BEG},
-        {"<SPACING_Y_MEM_MEM>", kTAG_YMM_BEG},
-        {"<SPACING_X_SOC_SOC>", kTAG_XSS_BEG},
-        {"<SPACING_Y_SOC_SOC>", kTAG_YSS_BEG},
-        {"<SPACING_X_MEM_SOC>", kTAG_XMS_BEG},
-        {"<SPACING_Y_MEM_SOC>", kTAG_YMS_BEG},
-        {"<SPACING_X_MEM_INTERPOSER>", kTAG_XMI_BEG},
-        {"<SPACING_Y_MEM_INTERPOSER>", kTAG_YMI_BEG},
-        {"<SPACING_X_SOC_INTERPOSER>", kTAG_XSI_BEG},
-        {"<SPACING_Y_SOC_INTERPOSER>", kTAG_YSI_BEG},
-        {"</CONSTRAINT>", kTAG_CONSTRAINT_END},
-        {"</PATTERN>", kTAG_PATTERN_END},
-        {"</SPACING_X_MEM_MEM>", kTAG_XMM_END},
-        {"</SPACING_Y_MEM_MEM>", kTAG_YMM_END},
-        {"</SPACING_X_SOC_SOC>", kTAG_XSS_END},
-        {"</SPACING_Y_SOC_SOC>", kTAG_YSS_END},
-        {"</SPACING_X_MEM_SOC>", kTAG_XMS_END},
-        {"</SPACING_Y_MEM_SOC>", kTAG_YMS_END},
-        {"</SPACING_X_MEM_INTERPOSER>", kTAG_XMI_END},
-        {"</SPACING_Y_MEM_INTERPOSER>", kTAG_YMI_END},
-        {"</SPACING_X_SOC_INTERPOSER>", kTAG_XSI_END},
-        {"</SPACING_Y_SOC_INTERPOSER>", kTAG_YSI_END},
-        // constraint tag end
-
-        {"\\b([^<>]|&)+", kDATA},
-
-        {"<([^<\\?/]*)>", kTAG_BEG},
-        {"</([^<\\?/]*)>", kTAG_END},
-},
-  pattern_rules[] = {
-      {" +", kSPACE}, {"\\^", kVERTICAL}, {"&#60;", kHORIZONTAL},
-      {"S", kSOC},    {"M", kMEM},        {"\\|", kColumn},
+/**
+ * @brief receiver of tokens, so that a file is parsed while it is scanned.
+ * Texts are views into the scanned buffer, valid only during the call.
+ */
+class TokenHandler {
+ public:
+  virtual ~TokenHandler() = default;
+
+  virtual void on_token(RegexType, std::string_view) = 0;
+  virtual void on_end() = 0;  // the whole file is scanned
 };
 
+/**
+ * @brief read the integer at the beginning of text like atoi, and drop it
+ * together with the spaces after it
+ */
+inline int pop_int(std::string_view& text) {
+  int value = 0;
+  auto ret = std::from_chars(text.data(), text.data() + text.size(), value);
+  text.remove_prefix(ret.ptr - text.data());
+  while (!text.empty() && isspace(text.front())) {
+    text.remove_prefix(1);
+  }
+  return value;
+}
+
+/**
+ * @brief Tokenizer of xml files and patterns. A hand-written lexer decides
+ * the token at every position from its first characters, so a line is
+ * scanned once. Tokens are the same as those of the rules below, in which
+ * the first rule matching at the position wins:
+ *
+ * kXML:     " +", "<?[a-z0-9 =\".]+?>", literal tags like "<MEM>",
+ *           "\b([^<>]|&)+" as kDATA, "<([^<?/]*)>" and "</([^<?/]*)>" as
+ *           unknown tags
+ * kPATTERN: " +", "^", "&#60;", "S", "M", "|"
+ */
 class Regex {
  public:
   // constructor
@@ -150,81 +129,35 @@ class Regex {
   ~Regex();
 
   // getter
-  auto get_num_regex() const { return _num_regex; }
-  auto get_regexs() const { return _regexs; }
   Token_List& get_tokens() { return _tokens; }
-  auto get_rules() const { return _rules; }
   auto get_mode() const { return _mode; }
 
   // setter
-  void set_num_regex(int num) { _num_regex = num; }
-  void set_rules(RegexRule* rules) { _rules = rules; }
   void set_mode(RegexMode mode) { _mode = mode; }
+  void set_handler(TokenHandler* handler) { _handler = handler; }
 
   // function
-  bool make_tokens(char*);
+  bool make_tokens(const char*);
+  bool make_tokens(const char*, const char*);
   void reset_tokens();
 
  private:
   // function
-  void trim_nr(char*);
-  void init_mode();
+  bool make_line_tokens(const char*, const char*);
+  RegexType match_xml(const char*, const char*, size_t&);
+  RegexType match_pattern(const char*, const char*, size_t&);
 
   // members
-  int _num_regex;
-  regex_t* _regexs;    // regexs compiled successfully
-  Token_List _tokens;  // tokens that matched by regexs
-  RegexRule* _rules;   // compiling rules
+  Token_List _tokens;       // tokens that matched by rules
+  TokenHandler* _handler;  // gets tokens instead of _tokens if set
   RegexMode _mode;
 };
 
-inline void Regex::init_mode() {
-  ASSERT(_mode != kMODE_NULL, "Regex Mode should not be null!");
-
-  char error_msg[128];
-  _regexs = (regex_t*)malloc(sizeof(regex_t) * _num_regex);
-  for (int i = 0, ret; i < _num_regex; ++i) {
-    ret = regcomp(&_regexs[i], _rules[i].regex.c_str(),
-                  REG_EXTENDED | REG_NEWLINE);
-    if (ret != 0) {
-      regerror(ret, &_regexs[i], error_msg, sizeof(error_msg));
-      PANIC("regex compilation failed: %s\n%s", error_msg,
-            _rules[i].regex.c_str());
-    }
-  }
-}
-
 inline Regex::~Regex() {
-  for (int i = 0; i < _num_regex; ++i) {
-    regfree(_regexs + i);
-  }
-  free(_regexs);
-  _regexs = nullptr;
-  
   _tokens.clear();
-  _rules = nullptr;
-  _num_regex = 0;
   _mode = kMODE_NULL;
 }
 
-/**
- * @brief Because it seems impossible to match '\\n' and '\\r', Remove these
- * characters
- *
- *
- * @param str string to match
- */
-inline void Regex::trim_nr(char* str) {
-  char* p_end = str + strlen(str) - 1;
-  for (; p_end >= str; --p_end) {
-    if (*p_end == '\r' || *p_end == '\n') {
-      *p_end = '\0';
-    } else {
-      break;
-    }
-  }
-}
-
 inline void Regex::reset_tokens() { _tokens.resize(0); }
 
 }  // namespace EDA_CHALLENGE_Q4
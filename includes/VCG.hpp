@@ -1,13 +1,21 @@
 #ifndef __VCG_HPP_
 #define __VCG_HPP_
 
+#include <string.h>
+
+#include <algorithm>
+#include <bitset>
+#include <chrono>
+#include <functional>
 #include <list>
 #include <queue>
 #include <set>
+#include <unordered_map>
 
 #include "CellManager.hpp"
 #include "ConstraintManager.hpp"
 #include "Debug.h"
+#include "ObjectPool.hpp"
 #include "Regex.hpp"
 
 namespace EDA_CHALLENGE_Q4 {
@@ -24,6 +32,57 @@ enum PTNodeType {
   kPTWheel
 };
 
+typedef std::bitset<256> VCGIdSet;  // bit i set if vcg_id i is in set
+
+/**
+ * @brief Columns [col_begin, col_end) and rows [row_begin, row_end) of a
+ * row-major grid, row 0 is top. Views only point into the grid owned by VCG,
+ * so slicing a view copies nothing.
+ */
+class GridView {
+ public:
+  // constructor
+  GridView() = default;
+  GridView(const uint8_t*, uint16_t, uint16_t);
+
+  // getter
+  size_t get_cols() const { return _col_end - _col_begin; }
+  size_t get_rows() const { return _row_end - _row_begin; }
+  uint8_t at(size_t col, size_t row) const {
+    return _data[(_row_begin + row) * _stride + _col_begin + col];
+  }
+
+  // function
+  GridView sub_cols(size_t, size_t) const;
+  GridView sub_rows(size_t, size_t) const;
+  GridView find(uint8_t) const;
+
+ private:
+  // members
+  const uint8_t* _data = nullptr;
+  uint16_t _stride = 0;  // columns of the whole grid
+  uint16_t _col_begin = 0;
+  uint16_t _col_end = 0;
+  uint16_t _row_begin = 0;
+  uint16_t _row_end = 0;
+};
+
+/**
+ * @brief Settings of pick search, given by Flow to every VCG. Budgets only
+ * apply after a pt_node has collected a full beam.
+ */
+struct SearchConfig {
+  SearchConfig();
+
+  size_t _beam_width;   // picks kept in one pt_node
+  bool _adaptive;       // beam wider near root and narrower near leaves
+  size_t _pair_budget;  // stop merging a pt_node when best death is not
+                        // improved in so many pairs, 0 means no limit
+  size_t _time_budget;  // as _pair_budget, in milliseconds
+  size_t _threads;      // threads merging picks of one pt_node
+  bool _lazy;           // merge pairs best-first, on one thread
+};
+
 class PickItem {
  public:
   // constructor
@@ -39,73 +98,159 @@ class PickItem {
   int _c1_y;
 };
 
+// vcg_ids of a PickHelper in pick order
+struct VCGIdRange {
+  const uint8_t* begin() const { return _begin; }
+  const uint8_t* end() const { return _end; }
+
+  const uint8_t* _begin;
+  const uint8_t* _end;
+};
+
+/**
+ * @brief Items of a pick are stored as arrays in one block, indexed directly
+ * by vcg_id. Copying or merging helpers only copies the block.
+ */
 class PickHelper {
  public:
   // constructor
-  PickHelper(uint8_t, int, bool);
+  PickHelper(uint16_t, uint16_t, uint8_t, Cell*);
   PickHelper(PickHelper*, PickHelper*);
   PickHelper(PickHelper*);
-  PickHelper(PickHelper *, PickHelper *, PickHelper *, PickHelper *, PickHelper *);
   ~PickHelper();
 
+  // allocator
+  static void* operator new(size_t size) {
+    return ObjectPool::alloc(_pool, size);
+  }
+  static void operator delete(void* p) { ObjectPool::free(p); }
+  static thread_local ObjectPool* _pool;       // pool of calling thread
+  static thread_local ObjectPool* _data_pool;  // pool of item arrays
+
   // getter
-  auto get_items() const { return _items; }
   auto get_box() const { return _box; }
   auto get_death() const { return _death; }
-  auto get_items_num() const { return _items.size(); }
+  auto get_order() const { return _order; }
+  auto get_hash() const { return _hash; }
+  auto get_items_num() const { return _items_num; }
+  auto get_slots() const { return _slots; }
+  auto get_classes() const { return _classes; }
+  VCGIdRange get_vcg_ids() const { return {_vcg_id, _vcg_id + _items_num}; }
+  PickItem get_item(uint8_t) const;
+  bool has_item(uint8_t vcg_id) const { return _id_set.test(vcg_id); }
+  int get_cell_id(uint8_t vcg_id) const { return _cell_id[vcg_id]; }
+  int get_cell_index(uint8_t vcg_id) const { return _cell_index[vcg_id]; }
+  int get_cell_class(uint8_t vcg_id) const { return _cell_class[vcg_id]; }
+  int get_class_num(int c) const { return _class_num[c]; }
+  bool get_rotation(uint8_t vcg_id) const { return _rotation[vcg_id]; }
+  int get_x(uint8_t vcg_id) const { return _c1_x[vcg_id]; }
+  int get_y(uint8_t vcg_id) const { return _c1_y[vcg_id]; }
+  static size_t get_data_size(uint16_t, uint16_t);
 
   // setter
   void set_box(const Rectangle& r) { _box = r; }
   void set_box(int, int, int, int);
   void set_death(float d) { _death = d; }
+  void set_order(size_t order) { _order = order; }
+  void set_cell(uint8_t, Cell*);
+  void set_x(uint8_t vcg_id, int x) { _c1_x[vcg_id] = x; }
+  void set_y(uint8_t vcg_id, int y) { _c1_y[vcg_id] = y; }
 
   // function
-  PickItem* get_item(uint8_t);
-  void get_items(const std::set<uint8_t>&, std::vector<PickItem*>&);
-  PickHelper* get_pt_node_helper(uint8_t, int);
-  void insert_source(PickHelper*);
-  bool is_picked(int);
+  void get_items(const VCGIdSet&, std::vector<uint8_t>&);
+  void move_x(int);
+  void move_y(int);
+  bool is_cells_exceed(PickHelper*, const uint8_t*) const;
+  int compare_cells(PickHelper*) const;
+  bool is_same_place(PickHelper*) const;
+  void update_hash();
   void reset_pos();
 
  private:
+  // function
+  void alloc_data(uint16_t, uint16_t);
+  void copy_data(PickHelper*);
+  void insert_items(PickHelper*);
+
   // members
-  std::vector<PickItem*> _items;
-  std::map<uint8_t, PickItem*> _id_item_map;  // vcg_id->item
+  uint16_t _slots;           // length of item arrays, vcg_id < _slots
+  uint16_t _classes;         // length of _class_num
+  uint8_t _items_num;
+  VCGIdSet _id_set;          // vcg_ids picked
+  char* _data;               // block of item arrays below
+  uint8_t* _class_num;       // cells picked of every cell class
+  uint8_t* _vcg_id;          // vcg_ids in pick order
+  bool* _rotation;           // _rotation to _c1_y are indexed by vcg_id
+  int* _cell_id;             // first cell of class until set_cells_by_helper
+  int* _cell_index;
+  int* _cell_class;
+  int* _c1_x;
+  int* _c1_y;
   Rectangle _box;
   float _death;
+  size_t _order;  // breaks ties of death, unique among picks of one pt_node
+  uint64_t _hash;  // of placement relative to box, see update_hash()
 };
 
 struct CmpPickHelperDeath {
   bool operator()(PickHelper*, PickHelper*);
 };
 
+/**
+ * @brief Max-heap of picks by (death, order), top is the worst pick. Picks
+ * are also indexed by hash, so a pick with the same placement as one in
+ * queue is found in O(1).
+ */
+class DeathQue {
+ public:
+  // getter
+  auto size() const { return _heap.size(); }
+  auto top() const { return _heap.front(); }
+  auto get_same_num() const { return _same_num; }
+
+  // function
+  void push(PickHelper*);
+  void pop();
+  PickHelper* find_same(PickHelper*);
+  void reorder();
+  void add_same_num(size_t num) { _same_num += num; }
+
+ private:
+  // members
+  std::vector<PickHelper*> _heap;
+  std::unordered_multimap<uint64_t, PickHelper*> _hash_map;
+  size_t _same_num = 0;  // picks found by find_same()
+};
+
 class PTNode {
   typedef std::vector<PickHelper*> Picks;
 
  public:
   // constructor
   PTNode() = default;
-  PTNode(int, PTNodeType, const GridType&);
+  PTNode(int, PTNodeType, const GridView&);
   ~PTNode();
 
   // getter
   auto get_type() const { return _type; }
   auto get_parent() const { return _parent; }
   auto get_pt_id() const { return _pt_id; }
-  auto get_children() const { return _children; }
-  auto get_picks() const { return _picks; }
-  auto get_grid() const { return _grid; }
+  const std::vector<PTNode*>& get_children() const { return _children; }
+  const Picks& get_picks() const { return _picks; }
+  const GridView& get_grid() const { return _grid; }
+  const VCGIdSet& get_grid_lefts() const { return _lefts; }
+  const VCGIdSet& get_grid_rights() const { return _rights; }
+  const VCGIdSet& get_grid_tops() const { return _tops; }
+  const VCGIdSet& get_grid_bottoms() const { return _bottoms; }
+  auto get_cells_num() const { return _cells_num; }
 
   // setter
   void set_parent(PTNode*);
+  void set_picks(Picks&& picks) { _picks = std::move(picks); }
 
   // function
   void insert_child(PTNode*);
   void insert_pick(PickHelper*);
-  void get_grid_lefts(std::set<uint8_t>&);
-  void get_grid_rights(std::set<uint8_t>&);
-  void get_grid_tops(std::set<uint8_t>&);
-  void get_grid_bottoms(std::set<uint8_t>&);
 
  private:
   // members
@@ -113,23 +258,44 @@ class PTNode {
   PTNodeType _type;
   PTNode* _parent;
   std::vector<PTNode*> _children;
-  GridType _grid;
+  GridView _grid;
+  VCGIdSet _lefts;    // vcg_ids in first column of grid
+  VCGIdSet _rights;   // vcg_ids in last column of grid
+  VCGIdSet _tops;     // first vcg_id of every column
+  VCGIdSet _bottoms;  // last vcg_id of every column
+  size_t _cells_num;  // vcg_ids in grid
   Picks _picks;
 };
 
 class PatternTree {
-  typedef std::priority_queue<PickHelper*, std::vector<PickHelper*>,
-                              CmpPickHelperDeath>
-      DeathQue;
+  // pools and counters of one merging thread
+  struct MergeWorker {
+    MergeWorker(size_t, size_t);
+
+    ObjectPool _helper_pool;  // PickHelpers created by this worker
+    ObjectPool _data_pool;    // item arrays of these PickHelpers
+    size_t _pair_num;         // pairs merged
+    size_t _repeat_num;       // cell-conflict checks
+    size_t _stop_num;         // merges stopped by budget
+    size_t _bound_num;        // pairs skipped by lower bound of death
+    float _best_death;        // best death merged in current pt_node
+  };
+
+  // a child of multi-child pt_node, with its neighbours merged before it
+  struct MergeStep {
+    PTNode* _child;
+    VCGIdSet _lefts;    // vcg_ids just left of child
+    VCGIdSet _bottoms;  // vcg_ids just below child
+  };
 
  public:
   // constructor
-  PatternTree(GridType&, std::map<uint8_t, VCGNodeType>&);
+  PatternTree(const GridView&, std::map<uint8_t, VCGNodeType>&);
   ~PatternTree();
 
   // sjc change.
-  bool is_interposer_left(uint8_t);
-  bool is_interposer_bottom(uint8_t);
+  bool is_interposer_left(uint8_t id) const { return _lefts.test(id); }
+  bool is_interposer_bottom(uint8_t id) const { return _bottoms.test(id); }
 
   // getter
   PTNode* get_pt_node(int);
@@ -138,6 +304,7 @@ class PatternTree {
   void set_cst(Constraint*);
   void set_cm(CellManager*);
   void set_vcg(VCG*);
+  void set_config(const SearchConfig&);
 
   // function
   void postorder_traverse();
@@ -145,7 +312,7 @@ class PatternTree {
   void get_cst_x(CellType, CellType, Point&);
   void get_cst_y(CellType, Point&);
   void get_cst_y(CellType, CellType, Point&);
-  void set_cell_status(Cell*, PickItem*);
+  void set_cell_status(Cell*, const PickItem&);
   PTNode* get_biggest_column(uint8_t);
 
  private:
@@ -154,14 +321,15 @@ class PatternTree {
   // setter
 
   // function
-  void slice(const GridType&, std::map<uint8_t, VCGNodeType>&);
-  void slice_module(const GridType&, bool&, std::queue<GridType>&);
-  void slice_vertical(const GridType&, std::queue<GridType>&);
-  void slice_horizontal(const GridType&, std::queue<GridType>&);
-  void insert_leaves(int, const GridType&, std::map<uint8_t, VCGNodeType>&);
-  void get_topological_sort(const GridType&, std::vector<uint8_t>&);
-  void get_in_edges(const GridType&, std::map<uint8_t, std::set<uint8_t>>&);
-  void get_zero_in_nodes(const GridType&,
+  static uint16_t count_slots(const std::map<uint8_t, VCGNodeType>&);
+  void slice(const GridView&, std::map<uint8_t, VCGNodeType>&);
+  void slice_module(const GridView&, bool&, std::queue<GridView>&);
+  void slice_vertical(const GridView&, std::queue<GridView>&);
+  void slice_horizontal(const GridView&, std::queue<GridView>&);
+  void insert_leaves(int, const GridView&, std::map<uint8_t, VCGNodeType>&);
+  void get_topological_sort(const GridView&, std::vector<uint8_t>&);
+  void get_in_edges(const GridView&, std::map<uint8_t, std::set<uint8_t>>&);
+  void get_zero_in_nodes(const GridView&,
                          const std::map<uint8_t, std::set<uint8_t>>&,
                          std::queue<uint8_t>&);
   PTNodeType get_pt_type(VCGNodeType);
@@ -169,32 +337,53 @@ class PatternTree {
   void debug_show_pt_grid_map();
   void visit_pt_node(int);
   void list_possibility(PTNode*);
+  void prune_dominated(PTNode*);
   void get_celltype(PTNodeType, CellType&);
   void merge_hrz(PTNode*);
   bool is_pick_repeat(PickHelper*, PickHelper*);
-  void adjust_interposer_left(std::vector<PickItem*>&);
-  void adjust_interposer_bottom(std::vector<PickItem*>&);
-
-  void clear_queue(std::queue<GridType>&);
-  void get_box_range_fit_litems(const std::vector<PickItem*>&,
-                                const std::vector<PickItem*>&, int, Point&);
-  void get_box_range_fit_bitems(const std::vector<PickItem*>&,
-                                const std::vector<PickItem*>&, int, Point&);
+  void adjust_interposer_left(PickHelper*, const std::vector<uint8_t>&);
+  void adjust_interposer_bottom(PickHelper*, const std::vector<uint8_t>&);
+
+  void clear_queue(std::queue<GridView>&);
+  void get_box_range_fit_litems(PickHelper*, const std::vector<uint8_t>&,
+                                PickHelper*, const std::vector<uint8_t>&, int,
+                                Point&);
+  void get_box_range_fit_bitems(PickHelper*, const std::vector<uint8_t>&,
+                                PickHelper*, const std::vector<uint8_t>&, int,
+                                Point&);
   bool is_overlap_y(Cell*, Cell*, bool);
   bool is_overlap_x(Cell*, Cell*, bool);
   bool is_overlap(int, int, int, int, bool);
+  Rectangle get_item_box(PickHelper*, uint8_t) const;
+  CellType get_item_type(PickHelper*, uint8_t) const;
   void debug_GDS(PickHelper*);
   void get_helper_box(PickHelper*, Rectangle&);
   int get_cells_area(PickHelper*);
   void merge_vtc(PTNode*);
-  bool insert_death_que(DeathQue&, PickHelper*);
+  bool insert_death_que(DeathQue&, PickHelper*, size_t);
+  size_t get_beam_width(PTNode*);
   int get_pt_id(uint8_t);
   void second_pick_replace(PickHelper*, PickHelper*);
   void replace(PickHelper*);
   void get_from_vcg_ids(uint8_t, std::set<uint8_t>&);
-  bool is_pick_same(PickHelper*, PickHelper*);
   void second_pick_replace(PTNode*, PTNode*, DeathQue&);
-  void merge_wheel(PTNode *);
+  void merge_children(PTNode*);
+  void get_merge_steps(PTNode*, std::vector<MergeStep>&);
+  PickHelper* place_child(PickHelper*, const MergeStep&, PickHelper*);
+  void parallel_merge(
+      size_t, const std::function<void(size_t, MergeWorker&, DeathQue&)>&,
+      size_t, DeathQue&);
+  bool is_over_budget(size_t, std::chrono::steady_clock::time_point);
+  bool is_bound_out(const DeathQue&, size_t, int, int, int);
+  float get_death_bound(int, int, int);
+  void lazy_merge(
+      size_t, const std::function<PickHelper*(size_t, std::vector<uint8_t>&)>&,
+      const std::vector<PickHelper*>&, const std::vector<int>&, bool,
+      const std::function<void(PickHelper*, const std::vector<uint8_t>&,
+                               size_t, size_t, MergeWorker&, DeathQue&)>&,
+      size_t, DeathQue&);
+  void debug_alloc_stat(size_t);
+  void debug_traverse_stat(double);
 
 
   // members
@@ -203,6 +392,15 @@ class PatternTree {
   CellManager* _cm;
   Constraint* _cst;
   VCG* _vcg;
+  uint16_t _slots;          // item slots of PickHelper, max vcg_id + 1
+  uint16_t _classes;        // cell classes of PickHelper
+  std::vector<uint8_t> _class_amount;  // cells of every class, at most 255
+  size_t _same_num;         // picks rejected as same placement
+  VCGIdSet _lefts;          // vcg_ids next to left side of interposer
+  VCGIdSet _bottoms;        // vcg_ids next to bottom side of interposer
+  SearchConfig _config;
+  std::vector<MergeWorker*> _workers;  // picks of this tree live in their
+                                       // pools, workers[0] is main thread
 };
 
 class VCGNode {
@@ -281,12 +479,14 @@ class VCG {
   PatternTree* get_pattern_tree() const { return _tree; }
   CellManager* get_cell_manager() const { return _cm; }
   std::vector<VCGNode*> get_vcg_nodes() const { return _adj_list; }
+  const GridType& get_id_grid() const { return _id_grid; }
 
   // sjc change.
   void get_cst_x(uint8_t, Point&);
   void get_cst_x(uint8_t, uint8_t, Point&);
   void get_cst_y(uint8_t, Point&);
   void get_cst_y(uint8_t, uint8_t, Point&);
+  void get_interposer_c3(int[4]);
 
   // void set_cells_by_helper(PickHelper* helper);
 
@@ -301,6 +501,8 @@ class VCG {
   // setter
   void set_cell_man(CellManager*);
   void set_constraint(Constraint*);
+  void set_gds_file_num(size_t num) { _gds_file_num = num; }
+  void set_search_config(const SearchConfig& c) { _tree->set_config(c); }
 
   // function
   void do_pick_cell(uint8_t, Cell*);
@@ -312,13 +514,10 @@ class VCG {
   void show_id_grid();
   void find_best_place();
   void gen_GDS();
-  void gen_result();
+  void gen_result(std::ostream&);
   void update_pitem(Cell*);
   void set_cells_by_helper(PickHelper*);
 
-  // members
-  static size_t _gds_file_num;
-
  private:
   // version 2
   void init_pattern_tree();
@@ -337,7 +536,8 @@ class VCG {
   void init_tos();
   void init_column_row_index();
   void debug();
-  void get_interposer_c3(int[4]);
+  bool is_topology_infeasible();
+  bool is_axis_infeasible(bool);
   // void get_cst_x(uint8_t, Point&);
   // void get_cst_x(uint8_t, uint8_t, Point&);
   // void get_cst_y(uint8_t, Point&);
@@ -347,10 +547,13 @@ class VCG {
   // members
   std::vector<VCGNode*> _adj_list;  // Node0 is end, final Node is start
   GridType _id_grid;                // pattern matrix [column][row]
+  std::vector<uint8_t> _flat_grid;  // _id_grid row by row, viewed by PTNodes
   CellManager* _cm;
   Constraint* _cst;
   PatternTree* _tree;
   PickHelper* _helper;
+  size_t _gds_file_num;  // suffix of gds file, pattern index in constraint
+  bool _infeasible;      // rejected before traversal, result is NA
 };
 
 // VCGNode
@@ -595,13 +798,87 @@ inline bool PatternTree::is_overlap(int c1_min, int c1_max, int c2_min,
               : !(c1_min >= c2_max || c1_max <= c2_min);
 }
 
+/* box of item in helper, cell objects are not touched */
+inline Rectangle PatternTree::get_item_box(PickHelper* helper,
+                                           uint8_t vcg_id) const {
+  auto& shape = _cm->get_shape(helper->get_cell_index(vcg_id));
+  bool rotation = helper->get_rotation(vcg_id);
+  Point c1(helper->get_x(vcg_id), helper->get_y(vcg_id));
+  Point c3(c1._x + (rotation ? shape._height : shape._width),
+           c1._y + (rotation ? shape._width : shape._height));
+  return Rectangle(c1, c3);
+}
+
+inline CellType PatternTree::get_item_type(PickHelper* helper,
+                                           uint8_t vcg_id) const {
+  return _cm->get_shape(helper->get_cell_index(vcg_id))._type;
+}
+
 // inline bool VCG::is_overlap(Rectangle r1, Rectangle r2, bool edge) {
 //   return is_overlap(r1._c1._x, r1._c3._x, r2._c1._x, r2._c3._x, edge)
 //       && is_overlap(r1._c1._y, r1._c3._y, r2._c1._y, r2._c3._y, edge);
 // }
 
-inline PTNode::PTNode(int pt_id, PTNodeType type, const GridType& grid)
-    : _pt_id(pt_id), _type(type), _parent(nullptr), _grid(grid) {}
+inline GridView::GridView(const uint8_t* data, uint16_t cols, uint16_t rows)
+    : _data(data),
+      _stride(cols),
+      _col_begin(0),
+      _col_end(cols),
+      _row_begin(0),
+      _row_end(rows) {}
+
+inline GridView GridView::sub_cols(size_t begin, size_t end) const {
+  ASSERT(begin < end && end <= get_cols(), "Columns out of view");
+  auto view = *this;
+  view._col_begin = _col_begin + begin;
+  view._col_end = _col_begin + end;
+  return view;
+}
+
+inline GridView GridView::sub_rows(size_t begin, size_t end) const {
+  ASSERT(begin < end && end <= get_rows(), "Rows out of view");
+  auto view = *this;
+  view._row_begin = _row_begin + begin;
+  view._row_end = _row_begin + end;
+  return view;
+}
+
+/* 1 x 1 view of the first position of id, column by column */
+inline GridView GridView::find(uint8_t id) const {
+  for (size_t col = 0; col < get_cols(); ++col) {
+    for (size_t row = 0; row < get_rows(); ++row) {
+      if (at(col, row) == id) {
+        return sub_cols(col, col + 1).sub_rows(row, row + 1);
+      }
+    }
+  }
+
+  PANIC("No vcg_id = %d in grid", id);
+  return GridView();
+}
+
+inline PTNode::PTNode(int pt_id, PTNodeType type, const GridView& grid)
+    : _pt_id(pt_id), _type(type), _parent(nullptr), _grid(grid) {
+  ASSERT(_grid.get_cols() && _grid.get_rows(), "Data error");
+  auto last_col = _grid.get_cols() - 1;
+  auto last_row = _grid.get_rows() - 1;
+  for (size_t row = 0; row <= last_row; ++row) {
+    _lefts.set(_grid.at(0, row));
+    _rights.set(_grid.at(last_col, row));
+  }
+  for (size_t col = 0; col <= last_col; ++col) {
+    _tops.set(_grid.at(col, 0));
+    _bottoms.set(_grid.at(col, last_row));
+  }
+
+  VCGIdSet ids;
+  for (size_t col = 0; col <= last_col; ++col) {
+    for (size_t row = 0; row <= last_row; ++row) {
+      ids.set(_grid.at(col, row));
+    }
+  }
+  _cells_num = ids.count();
+}
 
 inline void PTNode::insert_child(PTNode* pt_node) {
   if (pt_node && pt_node->get_pt_id() != _pt_id) {
@@ -616,16 +893,18 @@ inline void PTNode::set_parent(PTNode* parent) {
 }
 
 inline void PatternTree::get_in_edges(
-    const GridType& grid /*in*/,
+    const GridView& grid /*in*/,
     std::map<uint8_t, std::set<uint8_t>>& in_edges /*out*/) {
-  for (auto column : grid) {
-    for (size_t row = 0; row < column.size(); ++row) {
-      if (in_edges.count(column[row]) == 0) {
-        in_edges[column[row]] = {};
+  auto rows = grid.get_rows();
+  for (size_t col = 0; col < grid.get_cols(); ++col) {
+    for (size_t row = 0; row < rows; ++row) {
+      auto id = grid.at(col, row);
+      if (in_edges.count(id) == 0) {
+        in_edges[id] = {};
       }
-      if (row + 1 < column.size() && column[row] != column[row + 1] &&
-          in_edges[column[row]].count(column[row + 1]) == 0) {
-        in_edges[column[row]].insert(column[row + 1]);
+      if (row + 1 < rows && id != grid.at(col, row + 1) &&
+          in_edges[id].count(grid.at(col, row + 1)) == 0) {
+        in_edges[id].insert(grid.at(col, row + 1));
       }
     }
   }
@@ -690,6 +969,13 @@ inline void PatternTree::debug_show_pt_grid_map() {
 inline void PatternTree::set_cm(CellManager* cm) {
   if (cm && _cm == nullptr) {
     _cm = cm;
+    // picks count cells of every class instead of naming them
+    _classes = cm->get_classes_num();
+    _class_amount.resize(_classes);
+    for (uint16_t c = 0; c < _classes; ++c) {
+      // a pattern has at most UINT8_MAX vcg_ids, so it never picks more
+      _class_amount[c] = std::min<int>(cm->get_class_amount(c), UINT8_MAX);
+    }
   }
 }
 
@@ -699,17 +985,235 @@ inline void PatternTree::set_cst(Constraint* cst) {
   }
 }
 
+inline SearchConfig::SearchConfig()
+    : _beam_width(80),
+      _adaptive(false),
+      _pair_budget(0),
+      _time_budget(0),
+      _threads(1),
+      _lazy(false) {}
+
+inline void PatternTree::set_config(const SearchConfig& config) {
+  ASSERT(_workers.empty(), "Set config before traversal");
+  _config = config;
+  _config._beam_width = std::max<size_t>(_config._beam_width, 1);
+  _config._threads = std::max<size_t>(_config._threads, 1);
+}
+
+/**
+ * @brief true if a pair can not enter full queue. Merged box is at least
+ * width * height, so death is at least the death of such a box.
+ *
+ * @param num        picks kept in queue
+ * @param cell_area  cell area of both picks
+ */
+inline bool PatternTree::is_bound_out(const DeathQue& queue, size_t num,
+                                      int width, int height, int cell_area) {
+  if (queue.size() < num) return false;
+
+  return get_death_bound(width, height, cell_area) > queue.top()->get_death();
+}
+
+/* death of a box of width * height, holding cells of cell_area */
+inline float PatternTree::get_death_bound(int width, int height,
+                                          int cell_area) {
+  int area = width * height;
+  return 1.0 * (area - cell_area) / area;
+}
+
+inline PatternTree::MergeWorker::MergeWorker(size_t helper_size,
+                                             size_t data_size)
+    : _helper_pool(helper_size),
+      _data_pool(data_size),
+      _pair_num(0),
+      _repeat_num(0),
+      _stop_num(0),
+      _bound_num(0),
+      _best_death(0) {}
+
 inline void PatternTree::set_vcg(VCG* vcg) {
   if (vcg && _vcg == nullptr) {
     _vcg = vcg;
   }
 }
 
-inline PickHelper::PickHelper(uint8_t grid_value, int cell_id, bool rotation)
-    : _death(0) {
-  auto p = new PickItem(grid_value, cell_id, rotation, 0, 0);
-  _items.push_back(p);
-  _id_item_map[grid_value] = p;
+/**
+ * @param slots       max vcg_id + 1
+ * @param classes     cell classes in CellManager
+ * @param grid_value  vcg_id of cell
+ * @param cell        cell picked, with its current rotation
+ */
+inline PickHelper::PickHelper(uint16_t slots, uint16_t classes,
+                              uint8_t grid_value, Cell* cell)
+    : _items_num(0), _death(0), _order(0), _hash(0) {
+  ASSERT(grid_value < slots, "vcg_id = %d out of slots", grid_value);
+  alloc_data(slots, classes);
+  memset(_class_num, 0, classes);
+  _vcg_id[_items_num++] = grid_value;
+  _id_set.set(grid_value);
+  _rotation[grid_value] = cell->get_rotation();
+  _cell_id[grid_value] = 0;  // no previous cell
+  set_cell(grid_value, cell);
+  _c1_x[grid_value] = 0;
+  _c1_y[grid_value] = 0;
+}
+
+inline size_t PickHelper::get_data_size(uint16_t slots, uint16_t classes) {
+  return slots * (5 * sizeof(int) + sizeof(uint8_t) + sizeof(bool)) + classes;
+}
+
+/* carve all arrays from one block, wider types first for alignment */
+inline void PickHelper::alloc_data(uint16_t slots, uint16_t classes) {
+  _slots = slots;
+  _classes = classes;
+  _data = (char*)ObjectPool::alloc(_data_pool, get_data_size(slots, classes));
+  _cell_id = (int*)_data;
+  _cell_index = _cell_id + slots;
+  _cell_class = _cell_index + slots;
+  _c1_x = _cell_class + slots;
+  _c1_y = _c1_x + slots;
+  _vcg_id = (uint8_t*)(_c1_y + slots);
+  _rotation = (bool*)(_vcg_id + slots);
+  _class_num = (uint8_t*)(_rotation + slots);
+}
+
+inline void PickHelper::copy_data(PickHelper* helper) {
+  alloc_data(helper->_slots, helper->_classes);
+  memcpy(_data, helper->_data, get_data_size(_slots, _classes));
+}
+
+/**
+ * @brief pick cell for vcg_id, class counts follow the change
+ *
+ * @param cell  nullptr to leave vcg_id without cell
+ */
+inline void PickHelper::set_cell(uint8_t vcg_id, Cell* cell) {
+  if (_cell_id[vcg_id]) {
+    --_class_num[_cell_class[vcg_id]];
+  }
+
+  _cell_id[vcg_id] = cell ? cell->get_cell_id() : 0;
+  _cell_index[vcg_id] = cell ? cell->get_index() : 0;
+  _cell_class[vcg_id] = cell ? cell->get_class() : 0;
+  if (cell) {
+    ASSERT(cell->get_class() < _classes, "Cell class = %d out of range",
+           cell->get_class());
+    ++_class_num[cell->get_class()];
+  }
+}
+
+/* true if both helpers together pick more cells of a class than amounts */
+inline bool PickHelper::is_cells_exceed(PickHelper* helper,
+                                        const uint8_t* amounts) const {
+  for (uint16_t c = 0; c < _classes; ++c) {
+    if (_class_num[c] + helper->_class_num[c] > amounts[c]) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/* order of class counts, 0 if both helpers pick the same cells */
+inline int PickHelper::compare_cells(PickHelper* helper) const {
+  return memcmp(_class_num, helper->_class_num, _classes);
+}
+
+/* same cells, rotations and positions relative to box */
+inline bool PickHelper::is_same_place(PickHelper* helper) const {
+  if (_id_set != helper->_id_set) return false;
+
+  auto dx = helper->_box._c1._x - _box._c1._x;
+  auto dy = helper->_box._c1._y - _box._c1._y;
+  for (auto id : get_vcg_ids()) {
+    if (_cell_id[id] != helper->_cell_id[id] ||
+        _rotation[id] != helper->_rotation[id] ||
+        _c1_x[id] + dx != helper->_c1_x[id] ||
+        _c1_y[id] + dy != helper->_c1_y[id]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief hash of (vcg_id, cell_id, rotation, position relative to box) of all
+ * items in vcg_id order, so it does not depend on pick order. Call it after
+ * positions and box are final.
+ */
+inline void PickHelper::update_hash() {
+  uint64_t hash = 14695981039346656037ull;  // FNV-1a
+  auto mix = [&hash](int64_t value) {
+    hash ^= (uint64_t)value;
+    hash *= 1099511628211ull;
+  };
+  for (uint16_t id = 0; id < _slots; ++id) {
+    if (!_id_set.test(id)) continue;
+    mix(id);
+    mix(_cell_id[id]);
+    mix(_rotation[id]);
+    mix(_c1_x[id] - _box._c1._x);
+    mix(_c1_y[id] - _box._c1._y);
+  }
+  _hash = hash;
+}
+
+inline void DeathQue::push(PickHelper* helper) {
+  _heap.push_back(helper);
+  std::push_heap(_heap.begin(), _heap.end(), CmpPickHelperDeath());
+  _hash_map.emplace(helper->get_hash(), helper);
+}
+
+inline void DeathQue::pop() {
+  auto helper = top();
+  std::pop_heap(_heap.begin(), _heap.end(), CmpPickHelperDeath());
+  _heap.pop_back();
+
+  auto range = _hash_map.equal_range(helper->get_hash());
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second == helper) {
+      _hash_map.erase(it);
+      break;
+    }
+  }
+}
+
+inline PickHelper* DeathQue::find_same(PickHelper* helper) {
+  auto range = _hash_map.equal_range(helper->get_hash());
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second->is_same_place(helper)) {
+      ++_same_num;
+      return it->second;
+    }
+  }
+
+  return nullptr;
+}
+
+/* restore heap after death or order of a pick in queue changed */
+inline void DeathQue::reorder() {
+  std::make_heap(_heap.begin(), _heap.end(), CmpPickHelperDeath());
+}
+
+/* append items of helper, whose vcg_ids must not be picked yet */
+inline void PickHelper::insert_items(PickHelper* helper) {
+  ASSERT(helper->_slots == _slots && helper->_classes == _classes,
+         "Layout mismatch of helpers");
+  ASSERT((_id_set & helper->_id_set).none(), "vcg_id picked twice");
+  for (auto id : helper->get_vcg_ids()) {
+    _vcg_id[_items_num++] = id;
+    _rotation[id] = helper->_rotation[id];
+    _cell_id[id] = helper->_cell_id[id];
+    _cell_index[id] = helper->_cell_index[id];
+    _cell_class[id] = helper->_cell_class[id];
+    _c1_x[id] = helper->_c1_x[id];
+    _c1_y[id] = helper->_c1_y[id];
+  }
+  _id_set |= helper->_id_set;
+  for (uint16_t c = 0; c < _classes; ++c) {
+    _class_num[c] += helper->_class_num[c];
+  }
 }
 
 inline void PTNode::insert_pick(PickHelper* pick) {
@@ -741,12 +1245,9 @@ inline PickItem::PickItem(uint8_t grid_value, int cell_id, bool rotation,
       _c1_y(c1_y) {}
 
 inline PickHelper::~PickHelper() {
-  for (auto i : _items) {
-    delete i;
-  }
-  _items.clear();
-
-  _id_item_map.clear();
+  ObjectPool::free(_data);
+  _data = nullptr;
+  _items_num = 0;
 }
 
 inline PickItem::PickItem(const PickItem& p)
@@ -763,76 +1264,33 @@ inline void PickHelper::set_box(int c1_x, int c1_y, int c3_x, int c3_y) {
   _box._c3._y = c3_y;
 }
 
-inline void PTNode::get_grid_lefts(std::set<uint8_t>& set /*out*/) {
-  set.clear();
-  for (auto id : _grid[0]) {
-    set.insert(id);
-  }
-}
-
-inline void PTNode::get_grid_rights(std::set<uint8_t>& set /*out*/) {
-  set.clear();
-  ASSERT(_grid.size(), "Data error");
-  for (auto id : _grid[_grid.size() - 1]) {
-    set.insert(id);
-  }
-}
-
-inline void PTNode::get_grid_tops(std::set<uint8_t>& set /*out*/) {
-  set.clear();
-  for (auto column : _grid) {
-    set.insert(column[0]);
-  }
-}
-
-inline void PTNode::get_grid_bottoms(std::set<uint8_t>& set /*out*/) {
-  set.clear();
-  for (auto column : _grid) {
-    set.insert(column[column.size() - 1]);
-  }
-}
-
-inline void PickHelper::get_items(const std::set<uint8_t>& grid_set /*in*/,
-                                  std::vector<PickItem*>& items /*out*/) {
+/* picked vcg_ids of grid_set in ascending order */
+inline void PickHelper::get_items(const VCGIdSet& grid_set /*in*/,
+                                  std::vector<uint8_t>& items /*out*/) {
   items.clear();
-  for (auto id : grid_set) {
-    auto item = get_item(id);
-    if (item) {
-      items.push_back(item);
+  for (uint16_t id = 0; id < _slots; ++id) {
+    if (grid_set.test(id) && _id_set.test(id)) {
+      items.push_back(id);
     }
   }
 }
 
-inline PickItem* PickHelper::get_item(uint8_t vcg_id) {
-  return _id_item_map.count(vcg_id) ? _id_item_map[vcg_id] : nullptr;
+inline PickItem PickHelper::get_item(uint8_t vcg_id) const {
+  ASSERT(has_item(vcg_id), "No item whose vcg_id = %d", vcg_id);
+  return PickItem(vcg_id, _cell_id[vcg_id], _rotation[vcg_id], _c1_x[vcg_id],
+                  _c1_y[vcg_id]);
 }
 
-inline bool PatternTree::is_interposer_left(uint8_t id) {
-  ASSERT(_node_map.count(0), "Missing data, pt_id = 0");
-  auto grid = _node_map[0]->get_grid();
-  ASSERT(grid.size(), "Data error");
-
-  for (auto id_in_col : grid[0]) {
-    if (id_in_col == id) {
-      return true;
-    }
+inline void PickHelper::move_x(int x_move) {
+  for (auto id : get_vcg_ids()) {
+    _c1_x[id] += x_move;
   }
-
-  return false;
 }
 
-inline bool PatternTree::is_interposer_bottom(uint8_t id) {
-  ASSERT(_node_map.count(0), "Missing data, pt_id = 0");
-  auto grid = _node_map[0]->get_grid();
-  ASSERT(grid.size(), "Data error");
-
-  for (auto col : grid) {
-    if (col[col.size() - 1] == id) {
-      return true;
-    }
+inline void PickHelper::move_y(int y_move) {
+  for (auto id : get_vcg_ids()) {
+    _c1_y[id] += y_move;
   }
-
-  return false;
 }
 
 inline void PatternTree::get_cst_x(CellType c_type /*in*/,
@@ -917,8 +1375,8 @@ inline void PatternTree::get_cst_y(CellType c_type1 /*in*/,
   }
 }
 
-inline void PatternTree::clear_queue(std::queue<GridType>& q) {
-  std::queue<GridType> empty;
+inline void PatternTree::clear_queue(std::queue<GridView>& q) {
+  std::queue<GridView> empty;
   q.swap(empty);
 }
 
@@ -967,27 +1425,30 @@ inline CellType VCGNode::get_cell_type() {
 inline bool CmpPickHelperDeath::operator()(PickHelper* p1, PickHelper* p2) {
   if (!p1 || !p2) return false;
 
-  return p1->get_death() < p2->get_death();
+  if (p1->get_death() != p2->get_death()) {
+    return p1->get_death() < p2->get_death();
+  }
+  return p1->get_order() < p2->get_order();
 }
 
 inline void PatternTree::set_cell_status(Cell* cell /*out*/,
-                                         PickItem* item /*in*/) {
-  if (cell && item && cell->get_cell_id() == item->_cell_id) {
-    cell->set_x(item->_c1_x);
-    cell->set_y(item->_c1_y);
-    if (cell->get_rotation() != item->_rotation) {
+                                         const PickItem& item /*in*/) {
+  if (cell && cell->get_cell_id() == item._cell_id) {
+    cell->set_x(item._c1_x);
+    cell->set_y(item._c1_y);
+    if (cell->get_rotation() != item._rotation) {
       cell->rotate();
     }
   }
 }
 
-inline PickHelper::PickHelper(PickHelper* helper) : _death(0) {
-  for (auto item : helper->get_items()) {
-    _items.push_back(new PickItem(*item));
-  }
-  for (auto item : _items) {
-    _id_item_map[item->_vcg_id] = item;
-  }
+inline PickHelper::PickHelper(PickHelper* helper)
+    : _items_num(helper->_items_num),
+      _id_set(helper->_id_set),
+      _death(0),
+      _order(0),
+      _hash(0) {
+  copy_data(helper);
 }
 
 inline PTNode* PatternTree::get_pt_node(int pt_id) {
@@ -1010,20 +1471,10 @@ inline CellPriority VCG::get_priority(uint8_t vcg_id) {
   return kPrioNull;
 }
 
-inline bool PickHelper::is_picked(int cell_id) {
-  for (auto item : _items) {
-    if (item->_cell_id == cell_id) {
-      return true;
-    }
-  }
-
-  return false;
-}
-
 inline void PickHelper::reset_pos() {
-  for (auto item : _items) {
-    item->_c1_x = 0;
-    item->_c1_y = 0;
+  for (auto id : get_vcg_ids()) {
+    _c1_x[id] = 0;
+    _c1_y[id] = 0;
   }
 }
 
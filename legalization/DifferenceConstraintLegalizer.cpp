@@ -0,0 +1,256 @@
+#include "DifferenceConstraintLegalizer.h"
+
+#include <limits.h>
+
+#include <algorithm>
+#include <queue>
+
+#include "LegalizationCheck.h"
+
+namespace EDA_CHALLENGE_Q4 {
+
+/**
+ * @brief solve x and y graphs and move cells. Cells found facing after a move
+ * are related to each other and graphs are solved again, until no new pair
+ * faces. The placement is kept if a graph is infeasible or the result is not
+ * legal.
+ *
+ * @return false if spacing rules conflict, placement is kept then
+ */
+bool DifferenceConstraintLegalizer::executeLegalization() {
+  // no pick, like a pattern rejected before traversal
+  if (_vertexes.size() + 2 != _vcg->get_vcg_nodes().size()) return false;
+
+  std::vector<Point> origins;
+  for (auto node : _vertexes) {
+    origins.push_back(node->get_cell()->get_c1());
+  }
+
+  std::vector<ConstraintEdge> x_edges;
+  std::vector<ConstraintEdge> y_edges;
+  bool x_feasible = true;
+  bool y_feasible = true;
+  bool legal = false;
+  // every round adds a pair, so it ends within a round per pair of cells
+  size_t round = 0;
+  size_t max_round = _vertexes.size() * _vertexes.size() + 1;
+  while (round++ < max_round) {
+    x_edges.clear();
+    y_edges.clear();
+    buildGraph(true, x_edges);
+    buildGraph(false, y_edges);
+
+    std::vector<int> x_coords;
+    std::vector<int> y_coords;
+    x_feasible = solveLongestPath(x_edges, x_coords);
+    y_feasible = solveLongestPath(y_edges, y_coords);
+    if (!x_feasible || !y_feasible) break;
+
+    for (size_t i = 0; i < _vertexes.size(); ++i) {
+      _vertexes[i]->get_cell()->set_positon(x_coords[i + 1], y_coords[i + 1]);
+    }
+    if (!addFacingPairs()) {
+      LegalizationCheck checker(_vcg);
+      legal = checker.isPlacementLegal();
+      break;
+    }
+  }
+
+  if (!legal) {
+    for (size_t i = 0; i < _vertexes.size(); ++i) {
+      _vertexes[i]->get_cell()->set_positon(origins[i]._x, origins[i]._y);
+    }
+  }
+  debugStat(round, x_edges.size(), y_edges.size(), x_feasible, y_feasible,
+            legal);
+  return legal;
+}
+
+/**
+ * @brief number cells from 1, and collect relations and interposer sides.
+ * VCG keeps bottom/top relations as froms and tos, and left/right relations
+ * only in rows of _id_grid.
+ */
+void DifferenceConstraintLegalizer::initVertexes() {
+  _vertex_index.assign(_vcg->get_vertex_num(), 0);
+  for (auto node : _vcg->get_vcg_nodes()) {
+    auto type = node->get_type();
+    if (type == kVCG_START || type == kVCG_END) continue;
+    if (node->get_cell() == nullptr) continue;
+
+    _vertexes.push_back(node);
+    _vertex_index[node->get_vcg_id()] = _vertexes.size();
+  }
+
+  auto vertex_of = [&](uint8_t id) {
+    return id < _vertex_index.size() ? _vertex_index[id] : 0;
+  };
+  // y : froms are below, START is the bottom and END the top of interposer
+  for (size_t i = 0; i < _vertexes.size(); ++i) {
+    int v = i + 1;
+    for (auto from : _vertexes[i]->get_froms()) {
+      if (from->get_type() == kVCG_START) {
+        _bottom_vertexes.push_back(v);
+      } else if (vertex_of(from->get_vcg_id())) {
+        _y_adjacent_pairs.emplace(vertex_of(from->get_vcg_id()), v);
+      }
+    }
+    for (auto to : _vertexes[i]->get_tos()) {
+      if (to->get_type() == kVCG_END) _top_vertexes.push_back(v);
+    }
+  }
+
+  // x : neighbours in a row of the grid
+  auto& grid = _vcg->get_id_grid();
+  for (size_t col = 0; col < grid.size(); ++col) {
+    auto& column = grid[col];
+    for (size_t row = 0; row < column.size(); ++row) {
+      int v = vertex_of(column[row]);
+      if (v == 0) continue;
+
+      if (col == 0) _left_vertexes.push_back(v);
+      if (col + 1 == grid.size()) _right_vertexes.push_back(v);
+      if (col + 1 < grid.size() && row < grid[col + 1].size()) {
+        int right = vertex_of(grid[col + 1][row]);
+        if (right && right != v) _x_adjacent_pairs.emplace(v, right);
+      }
+    }
+  }
+
+  for (auto vec : {&_left_vertexes, &_right_vertexes, &_bottom_vertexes,
+                   &_top_vertexes}) {
+    std::sort(vec->begin(), vec->end());
+    vec->erase(std::unique(vec->begin(), vec->end()), vec->end());
+  }
+}
+
+/**
+ * @brief constraints of one axis. Vertex 0 and the sink are sides of
+ * interposer. Every related pair keeps its order and its min/max spacing:
+ * cells stacked in a grid column or next to each other in a grid row face
+ * each other, and so do pairs added by addFacingPairs().
+ */
+void DifferenceConstraintLegalizer::buildGraph(
+    bool is_x /*in*/, std::vector<ConstraintEdge>& edges /*out*/) {
+  int num = _vertexes.size();
+  int sink = num + 1;
+  auto cell_of = [&](int v) { return _vertexes[v - 1]->get_cell(); };
+  auto id_of = [&](int v) { return _vertexes[v - 1]->get_vcg_id(); };
+  auto len = [&](Cell* c, bool x) {
+    return int(x ? c->get_width() : c->get_height());
+  };
+
+  Point range;
+  for (int v = 1; v <= num; ++v) {
+    edges.emplace_back(0, v, 0);
+    edges.emplace_back(v, sink, len(cell_of(v), is_x));
+  }
+  for (auto v : is_x ? _left_vertexes : _bottom_vertexes) {
+    is_x ? _vcg->get_cst_x(id_of(v), range) : _vcg->get_cst_y(id_of(v), range);
+    edges.emplace_back(0, v, range._x);
+    edges.emplace_back(v, 0, -range._y);
+  }
+  for (auto v : is_x ? _right_vertexes : _top_vertexes) {
+    is_x ? _vcg->get_cst_x(id_of(v), range) : _vcg->get_cst_y(id_of(v), range);
+    int length = len(cell_of(v), is_x);
+    edges.emplace_back(v, sink, length + range._x);
+    edges.emplace_back(sink, v, -(length + range._y));
+  }
+
+  for (auto& pair : is_x ? _x_adjacent_pairs : _y_adjacent_pairs) {
+    int a = pair.first;
+    int b = pair.second;
+    is_x ? _vcg->get_cst_x(id_of(a), id_of(b), range)
+         : _vcg->get_cst_y(id_of(a), id_of(b), range);
+    int length = len(cell_of(a), is_x);
+    edges.emplace_back(a, b, length + range._x);
+    edges.emplace_back(b, a, -(length + range._y));
+  }
+}
+
+/**
+ * @brief longest paths from vertex 0 by queue-based Bellman-Ford, a vertex
+ * relaxed as many times as vertexes means a positive cycle
+ */
+bool DifferenceConstraintLegalizer::solveLongestPath(
+    const std::vector<ConstraintEdge>& edges /*in*/,
+    std::vector<int>& coords /*out*/) {
+  int num = _vertexes.size() + 2;
+  std::vector<std::vector<const ConstraintEdge*>> outs(num);
+  for (auto& edge : edges) {
+    outs[edge.from].push_back(&edge);
+  }
+
+  coords.assign(num, INT_MIN);
+  std::vector<int> relax_num(num, 0);
+  std::vector<bool> in_queue(num, false);
+  std::queue<int> que;
+  coords[0] = 0;
+  que.push(0);
+  in_queue[0] = true;
+  while (!que.empty()) {
+    int v = que.front();
+    que.pop();
+    in_queue[v] = false;
+    for (auto edge : outs[v]) {
+      int dist = coords[v] + edge->weight;
+      if (dist <= coords[edge->to]) continue;
+
+      coords[edge->to] = dist;
+      if (in_queue[edge->to]) continue;
+      if (++relax_num[edge->to] >= num) return false;
+      que.push(edge->to);
+      in_queue[edge->to] = true;
+    }
+  }
+  return true;
+}
+
+/**
+ * @brief relate cells that face each other in current placement and are not
+ * related yet, the lower coordinate first
+ *
+ * @return true if a pair is added
+ */
+bool DifferenceConstraintLegalizer::addFacingPairs() {
+  LegalizationCheck checker(_vcg);
+  bool added = false;
+  for (size_t i = 0; i < _vertexes.size(); ++i) {
+    int v = i + 1;
+    auto cell = _vertexes[i]->get_cell();
+    for (bool is_x : {true, false}) {
+      auto& pairs = is_x ? _x_adjacent_pairs : _y_adjacent_pairs;
+      int low = is_x ? cell->get_x() : cell->get_y();
+      for (auto other : checker.obtainFacingNodes(_vertexes[i], is_x)) {
+        int u = _vertex_index[other->get_vcg_id()];
+        auto other_cell = other->get_cell();
+        int other_low = is_x ? other_cell->get_x() : other_cell->get_y();
+        if (other_low > low || (other_low == low && u > v)) continue;
+        if (pairs.count({v, u})) continue;
+
+        added |= pairs.emplace(u, v).second;
+      }
+    }
+  }
+  return added;
+}
+
+void DifferenceConstraintLegalizer::debugStat(size_t round,
+                                              size_t x_edge_num,
+                                              size_t y_edge_num,
+                                              bool x_feasible, bool y_feasible,
+                                              bool legal) {
+#ifndef G_LOG
+  return;
+#endif
+  g_log << "[legalize] vertexes = " << _vertexes.size() + 2
+        << ", rounds = " << round        << ", x edges = " << x_edge_num
+        << (x_feasible ? "" : " (infeasible)")
+        << ", y edges = " << y_edge_num
+        << (y_feasible ? "" : " (infeasible)")
+        << (x_feasible && y_feasible && !legal ? ", illegal, restored" : "")
+        << "\n";
+  g_log.flush();
+}
+
+}  // namespace EDA_CHALLENGE_Q4
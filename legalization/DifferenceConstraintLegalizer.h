@@ -0,0 +1,67 @@
+#ifndef DIFFERENCE_CONSTRAINT_LEGALIZER
+#define DIFFERENCE_CONSTRAINT_LEGALIZER
+
+#include <set>
+#include <vector>
+
+#include "../includes/VCG.hpp"
+
+namespace EDA_CHALLENGE_Q4 {
+
+// coordinate of to - coordinate of from >= weight
+struct ConstraintEdge {
+  ConstraintEdge(int f, int t, int w) : from(f), to(t), weight(w) {}
+
+  int from;
+  int to;
+  int weight;
+};
+
+/**
+ * @brief Legalize spacing of placed cells by difference constraints, one
+ * graph per axis. Vertex 0 is the left (bottom) edge of interposer, the last
+ * vertex is its right (top) edge. Edges follow the relations of VCG: froms
+ * and tos on y axis, neighbours in rows of the id grid on x axis, so a graph
+ * has O(V) edges. Minimal coordinates are longest paths from vertex 0, a
+ * positive cycle means the spacing rules can not be met in that order.
+ * Cells that face each other only after a move are related and graphs are
+ * solved again. Moved cells must pass LegalizationCheck, or the placement is
+ * restored.
+ */
+class DifferenceConstraintLegalizer {
+ public:
+  DifferenceConstraintLegalizer() = delete;
+  DifferenceConstraintLegalizer(VCG* vcg);
+  ~DifferenceConstraintLegalizer() = default;
+
+  bool executeLegalization();
+
+ private:
+  VCG* _vcg;
+  std::vector<VCGNode*> _vertexes;  // vertex i + 1 of graphs
+  std::vector<int> _vertex_index;   // vcg_id -> vertex, 0 if no cell
+
+  // VCG relations and facing pairs, first is left of (below) second
+  std::set<std::pair<int, int>> _x_adjacent_pairs;
+  std::set<std::pair<int, int>> _y_adjacent_pairs;
+  std::vector<int> _left_vertexes;  // next to interposer
+  std::vector<int> _right_vertexes;
+  std::vector<int> _bottom_vertexes;
+  std::vector<int> _top_vertexes;
+
+  void initVertexes();
+  void buildGraph(bool is_x, std::vector<ConstraintEdge>& edges);
+  bool solveLongestPath(const std::vector<ConstraintEdge>& edges,
+                        std::vector<int>& coords);
+  bool addFacingPairs();
+  void debugStat(size_t, size_t, size_t, bool, bool, bool);
+};
+
+inline DifferenceConstraintLegalizer::DifferenceConstraintLegalizer(VCG* vcg)
+    : _vcg(vcg) {
+  initVertexes();
+}
+
+}  // namespace EDA_CHALLENGE_Q4
+
+#endif
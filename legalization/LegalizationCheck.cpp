@@ -12,6 +12,7 @@
 
 #include <limits.h>
 
+#include <algorithm>
 #include <iostream>
 
 namespace EDA_CHALLENGE_Q4 {
@@ -24,6 +25,114 @@ bool LegalizationCheck::isNumLegal(int num, Point range) {
   }
 }
 
+/**
+ * @brief true if no cells overlap, cells facing each other with nothing
+ * between keep their spacing, cells facing left (bottom) side of interposer
+ * keep its spacing, and windows of right (top) side meet as gen_result()
+ * requires.
+ */
+bool LegalizationCheck::isPlacementLegal() {
+  auto origin_nodes = _vcg->get_vcg_nodes();
+  for (auto it = origin_nodes.begin() + 1; it != origin_nodes.end() - 1;
+       ++it) {
+    if (!isVertexLegal(*it, true) || !isVertexLegal(*it, false)) {
+      return false;
+    }
+  }
+
+  int c3_arr[4];
+  _vcg->get_interposer_c3(c3_arr);
+  return c3_arr[0] <= c3_arr[1] && c3_arr[2] <= c3_arr[3];
+}
+
+/**
+ * @brief check node against the cells facing it from left (below)
+ */
+bool LegalizationCheck::isVertexLegal(VCGNode* node, bool is_x) {
+  auto cell = node->get_cell();
+  auto c1 = cell->get_c1();
+  auto c3 = cell->get_c3();
+  auto low = [is_x](Point p) { return is_x ? p._x : p._y; };
+  Point span = is_x ? Point(c1._y, c3._y) : Point(c1._x, c3._x);
+  auto nodes = is_x ? obtainXLeftNodes(low(c3), span)
+                    : obtainYDownNodes(low(c3), span);
+
+  std::vector<VCGNode*> befores;
+  for (auto other : nodes) {
+    if (other == node) continue;
+    if (low(other->get_cell()->get_c3()) > low(c1)) return false;  // overlap
+
+    befores.push_back(other);
+  }
+
+  Point range;
+  if (befores.empty()) {
+    is_x ? _vcg->get_cst_x(node->get_vcg_id(), range)
+         : _vcg->get_cst_y(node->get_vcg_id(), range);
+    return isNumLegal(low(c1), range);
+  }
+
+  for (auto other : obtainVisibleNodes(node, befores, is_x)) {
+    is_x ? _vcg->get_cst_x(other->get_vcg_id(), node->get_vcg_id(), range)
+         : _vcg->get_cst_y(other->get_vcg_id(), node->get_vcg_id(), range);
+    auto other_c3 = other->get_cell()->get_c3();
+    if (!isNumLegal(low(c1) - low(other_c3), range)) return false;
+  }
+  return true;
+}
+
+/**
+ * @brief cells starting left of (below) node whose spans face it with no
+ * cell between, overlapping cells included
+ */
+std::vector<VCGNode*> LegalizationCheck::obtainFacingNodes(VCGNode* node,
+                                                           bool is_x) {
+  auto cell = node->get_cell();
+  auto c1 = cell->get_c1();
+  auto c3 = cell->get_c3();
+  Point span = is_x ? Point(c1._y, c3._y) : Point(c1._x, c3._x);
+  auto nodes = is_x ? obtainXLeftNodes(c3._x, span)
+                    : obtainYDownNodes(c3._y, span);
+
+  std::vector<VCGNode*> befores;
+  for (auto other : nodes) {
+    if (other != node) befores.push_back(other);
+  }
+  return obtainVisibleNodes(node, befores, is_x);
+}
+
+/* befores facing node, other is blocked if a cell between meets its band */
+std::vector<VCGNode*> LegalizationCheck::obtainVisibleNodes(
+    VCGNode* node, const std::vector<VCGNode*>& befores, bool is_x) {
+  auto low = [is_x](Point p) { return is_x ? p._x : p._y; };
+  auto other_span = [is_x](Cell* c) {
+    return is_x ? Point(c->get_y(), c->get_c3()._y)
+                : Point(c->get_x(), c->get_c3()._x);
+  };
+  auto span = other_span(node->get_cell());
+
+  std::vector<VCGNode*> visibles;
+  for (auto other : befores) {
+    auto other_cell = other->get_cell();
+    auto o_span = other_span(other_cell);
+    int band_low = std::max(o_span._x, span._x);
+    int band_high = std::min(o_span._y, span._y);
+    bool blocked = false;
+    for (auto mid : befores) {
+      auto mid_cell = mid->get_cell();
+      auto m_span = other_span(mid_cell);
+      if (mid != other &&
+          low(mid_cell->get_c1()) >= low(other_cell->get_c3()) &&
+          m_span._x < band_high && band_low < m_span._y) {
+        blocked = true;
+        break;
+      }
+    }
+    if (!blocked) visibles.push_back(other);
+  }
+  return visibles;
+}
+
 bool LegalizationCheck::isLeftBoundaryViolated(VCGNode* node,
                                                int boundary_value) {
   auto cell = node->get_cell();
@@ -96,56 +205,36 @@ Point LegalizationCheck::obtainDownYRange(VCGNode* node) {
 
 std::vector<VCGNode*> LegalizationCheck::obtainXLeftNodes(int x_coord,
                                                           Point y_range) {
-  //
-  std::vector<VCGNode*> candidate_nodes;
-  for (auto pair : _x_to_vertexes) {
-    if (pair.first <= x_coord) {
-      continue;
-    }
-    if (pair.first >= x_coord) {
-      break;
-    }
-
-    candidate_nodes.insert(candidate_nodes.end(), pair.second.begin(),
-                           pair.second.end());
-  }
-
-  std::vector<VCGNode*> left_nodes;
-  for (auto node : candidate_nodes) {
-    auto cell = node->get_cell();
-    if (cell->get_x() < x_coord) {
-      left_nodes.push_back(node);
-    }
-  }
-
-  return left_nodes;
+  std::vector<int> ids;
+  _x_index.obtainBefore(x_coord, y_range, ids);
+  return obtainSortedNodes(ids, true);
 }
 
 std::vector<VCGNode*> LegalizationCheck::obtainYDownNodes(int y_coord,
                                                           Point x_range) {
-  //
-  std::vector<VCGNode*> candidate_nodes;
-  for (auto pair : _y_to_vertexes) {
-    if (pair.first <= y_coord) {
-      continue;
-    }
-    if (pair.first >= y_coord) {
-      break;
-    }
+  std::vector<int> ids;
+  _y_index.obtainBefore(y_coord, x_range, ids);
+  return obtainSortedNodes(ids, false);
+}
 
-    candidate_nodes.insert(candidate_nodes.end(), pair.second.begin(),
-                           pair.second.end());
+/**
+ * @brief nodes of ids, nearest to origin first like the coordinate maps
+ * they replace
+ */
+std::vector<VCGNode*> LegalizationCheck::obtainSortedNodes(
+    const std::vector<int>& ids, bool by_x) {
+  std::vector<VCGNode*> nodes;
+  for (auto id : ids) {
+    nodes.push_back(_vcg->get_node(id));
   }
-
-  std::vector<VCGNode*> down_nodes;
-  for (auto node : candidate_nodes) {
+  auto coord = [by_x](VCGNode* node) {
     auto cell = node->get_cell();
-    if (cell->get_y() < y_coord) {
-      down_nodes.push_back(node);
-    }
-  }
-
-  return down_nodes;
+    return by_x ? cell->get_x() : cell->get_y();
+  };
+  std::stable_sort(
+      nodes.begin(), nodes.end(),
+      [&coord](VCGNode* a, VCGNode* b) { return coord(a) < coord(b); });
+  return nodes;
 }
 
 void LegalizationCheck::updateVertexXYCoordRange(VCGNode* node) {
@@ -176,98 +265,51 @@ void LegalizationCheck::updateVertexXYCoordRange(VCGNode* node) {
 
 void LegalizationCheck::updateVertexLocInfo(VCGNode* node, Point new_coord) {
   auto cell = node->get_cell();
-  eraseXToVertexes(cell->get_x(), node);
-  eraseYToVertexes(cell->get_y(), node);
+  eraseVertexSpans(node);
 
   cell->set_positon(new_coord._x, new_coord._y);
 
-  addXToVertexes(cell->get_x(), node);
-  addYToVertexes(cell->get_y(), node);
+  addVertexSpans(node);
   updateVertexXYCoordRange(node);
 }
 
 void LegalizationCheck::updateVertexXCoord(VCGNode* node, int x_coord) {
   auto cell = node->get_cell();
-  eraseXToVertexes(cell->get_x(), node);
+  eraseVertexSpans(node);
 
   cell->set_x(x_coord);
 
-  addXToVertexes(cell->get_x(), node);
+  addVertexSpans(node);
 }
 
 void LegalizationCheck::updateVertexYCoord(VCGNode* node, int y_coord) {
   auto cell = node->get_cell();
-  eraseYToVertexes(cell->get_y(), node);
+  eraseVertexSpans(node);
 
   cell->set_y(y_coord);
 
-  addYToVertexes(cell->get_y(), node);
+  addVertexSpans(node);
 }
 
-void LegalizationCheck::eraseXToVertexes(int x_coord, VCGNode* node) {
-  auto it = _x_to_vertexes.find(x_coord);
-
-  if (it == _x_to_vertexes.end()) {
-    std::cout << "Error In delete node coordinate map." << std::endl;
-    exit(1);
-  }
-
-  auto node_it = std::find_if(
-      it->second.begin(), it->second.end(), [node](VCGNode* target_node) {
-        return node->get_vcg_id() == target_node->get_vcg_id();
-      });
-  if (node_it == it->second.end()) {
-    std::cout << "Error In delete node coordinate map." << std::endl;
-    exit(1);
-  }
-  it->second.erase(node_it);
+void LegalizationCheck::eraseVertexSpans(VCGNode* node) {
+  _x_index.eraseSpan(node->get_vcg_id());
+  _y_index.eraseSpan(node->get_vcg_id());
 }
 
-void LegalizationCheck::eraseYToVertexes(int y_coord, VCGNode* node) {
-  auto it = _y_to_vertexes.find(y_coord);
-
-  if (it == _y_to_vertexes.end()) {
-    std::cout << "Error In delete node coordinate map." << std::endl;
-    exit(1);
-  }
-
-  auto node_it = std::find_if(
-      it->second.begin(), it->second.end(), [node](VCGNode* target_node) {
-        return node->get_vcg_id() == target_node->get_vcg_id();
-      });
-  if (node_it == it->second.end()) {
-    std::cout << "Error In delete node coordinate map." << std::endl;
-    exit(1);
-  }
-  it->second.erase(node_it);
-}
-
-void LegalizationCheck::addXToVertexes(int x_coord, VCGNode* node) {
-  auto it = _x_to_vertexes.find(x_coord);
-  if (it == _x_to_vertexes.end()) {
-    std::vector<VCGNode*> nodes{node};
-    _x_to_vertexes.emplace(x_coord, nodes);
-  } else {
-    auto& nodes = it->second;
-    nodes.push_back(node);
-  }
-}
-
-void LegalizationCheck::addYToVertexes(int y_coord, VCGNode* node) {
-  auto it = _y_to_vertexes.find(y_coord);
-  if (it == _y_to_vertexes.end()) {
-    std::vector<VCGNode*> nodes{node};
-    _x_to_vertexes.emplace(y_coord, nodes);
-  } else {
-    auto& nodes = it->second;
-    nodes.push_back(node);
-  }
+void LegalizationCheck::addVertexSpans(VCGNode* node) {
+  auto cell = node->get_cell();
+  auto c1 = cell->get_c1();
+  auto c3 = cell->get_c3();
+  _x_index.insertSpan(node->get_vcg_id(), Point(c1._y, c3._y), c1._x);
+  _y_index.insertSpan(node->get_vcg_id(), Point(c1._x, c3._x), c1._y);
 }
 
 void LegalizationCheck::initVertexesInfo() {
   auto origin_nodes = _vcg->get_vcg_nodes();
   std::vector<VCGNode*> nodes;
   nodes.assign(origin_nodes.begin() + 1, origin_nodes.end() - 1);
+  _x_index.resize(origin_nodes.size());
+  _y_index.resize(origin_nodes.size());
 
   for (auto node : nodes) {
     // set the interposer info.
@@ -284,12 +326,7 @@ void LegalizationCheck::initVertexesInfo() {
     }
 
     // set the location info.
-    auto cell = node->get_cell();
-    int x_coord = cell->get_x();
-    int y_coord = cell->get_y();
-
-    addXToVertexes(x_coord, node);
-    addYToVertexes(y_coord, node);
+    addVertexSpans(node);
   }
 }
 
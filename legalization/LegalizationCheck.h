@@ -17,6 +17,7 @@
 
 #include "../includes/Point.hpp"
 #include "../includes/VCG.hpp"
+#include "SpanIndex.h"
 
 namespace EDA_CHALLENGE_Q4 {
 class LegalizationCheck {
@@ -26,6 +27,7 @@ class LegalizationCheck {
   ~LegalizationCheck() = default;
 
   bool isNumLegal(int num, Point range);
+  bool isPlacementLegal();
   bool isLeftBoundaryViolated(VCGNode* node, int boundary_value);
   bool isDownBoundaryViolated(VCGNode* node, int boundary_value);
   bool isLeftVertexViolated(VCGNode* left_node, VCGNode* right_node);
@@ -33,6 +35,7 @@ class LegalizationCheck {
 
   std::vector<VCGNode*> obtainXLeftNodes(int x_coord, Point y_range);
   std::vector<VCGNode*> obtainYDownNodes(int y_coord, Point x_range);
+  std::vector<VCGNode*> obtainFacingNodes(VCGNode* node, bool is_x);
 
   Point obtainLeftXRange(VCGNode* node);
   Point obtainDownYRange(VCGNode* node);
@@ -43,10 +46,8 @@ class LegalizationCheck {
 
   void updateVertexXYCoordRange(VCGNode* node);
 
-  void eraseXToVertexes(int x_coord, VCGNode* node);
-  void eraseYToVertexes(int y_coord, VCGNode* node);
-  void addXToVertexes(int x_coord, VCGNode* node);
-  void addYToVertexes(int y_coord, VCGNode* node);
+  void eraseVertexSpans(VCGNode* node);
+  void addVertexSpans(VCGNode* node);
 
   void set_left_x_range(VCGNode* node, Point range);
   void set_down_y_range(VCGNode* node, Point range);
@@ -77,11 +78,16 @@ class LegalizationCheck {
   std::map<VCGNode*, Point> _vertex_to_x_range;
   std::map<VCGNode*, Point> _vertex_to_y_range;
 
-  // record x y coordinates.
-  std::map<int, std::vector<VCGNode*>> _x_to_vertexes;
-  std::map<int, std::vector<VCGNode*>> _y_to_vertexes;
+  // record y spans by x coordinates, and x spans by y coordinates.
+  SpanIndex _x_index;
+  SpanIndex _y_index;
 
   void initVertexesInfo();
+  bool isVertexLegal(VCGNode* node, bool is_x);
+  std::vector<VCGNode*> obtainVisibleNodes(
+      VCGNode* node, const std::vector<VCGNode*>& befores, bool is_x);
+  std::vector<VCGNode*> obtainSortedNodes(const std::vector<int>& ids,
+                                          bool by_x);
 
 };  // namespace LegalizationCheck
 
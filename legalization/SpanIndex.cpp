@@ -0,0 +1,118 @@
+#include "SpanIndex.h"
+
+#include <algorithm>
+
+#include "../includes/Debug.h"
+
+namespace EDA_CHALLENGE_Q4 {
+
+/**
+ * @brief make room for vcg_id < id_num, drops all entries
+ */
+void SpanIndex::resize(size_t id_num) {
+  _entries.assign(id_num, Entry());
+  for (size_t id = 0; id < id_num; ++id) {
+    // fixed priorities keep the tree the same between runs
+    _entries[id].priority = (uint32_t)(id + 1) * 2654435761u;
+    _entries[id].indexed = false;
+  }
+  _root = kNull;
+}
+
+void SpanIndex::insertSpan(int id, Point span, int coord) {
+  ASSERT(id >= 0 && (size_t)id < _entries.size(), "No span slot for id = %d",
+         id);
+  ASSERT(!_entries[id].indexed, "Span of id = %d is indexed", id);
+  auto& entry = _entries[id];
+  entry.span = span;
+  entry.coord = coord;
+  entry.left = kNull;
+  entry.right = kNull;
+  entry.indexed = true;
+  update(id);
+
+  int before, after;
+  split(_root, span._x, id, before, after);
+  _root = merge(merge(before, id), after);
+}
+
+void SpanIndex::eraseSpan(int id) {
+  ASSERT(isIndexed(id), "Span of id = %d is not indexed", id);
+  int before, rest, self, after;
+  split(_root, _entries[id].span._x, id, before, rest);
+  split(rest, _entries[id].span._x, id + 1, self, after);
+  ASSERT(self == id, "Span index broken at id = %d", id);
+  _root = merge(before, after);
+  _entries[id].indexed = false;
+}
+
+/**
+ * @brief ids whose coordinate is less than coord and whose span overlaps
+ * span, ordered by span low
+ */
+void SpanIndex::obtainBefore(int coord /*in*/, Point span /*in*/,
+                             std::vector<int>& ids /*out*/) const {
+  ids.clear();
+  collect(_root, coord, span, ids);
+}
+
+void SpanIndex::update(int t) {
+  auto& entry = _entries[t];
+  entry.max_high = entry.span._y;
+  entry.min_coord = entry.coord;
+  for (auto child : {entry.left, entry.right}) {
+    if (child == kNull) continue;
+    entry.max_high = std::max(entry.max_high, _entries[child].max_high);
+    entry.min_coord = std::min(entry.min_coord, _entries[child].min_coord);
+  }
+}
+
+int SpanIndex::merge(int a, int b) {
+  if (a == kNull) return b;
+  if (b == kNull) return a;
+  if (_entries[a].priority > _entries[b].priority) {
+    _entries[a].right = merge(_entries[a].right, b);
+    update(a);
+    return a;
+  }
+  _entries[b].left = merge(a, _entries[b].left);
+  update(b);
+  return b;
+}
+
+/**
+ * @brief before gets entries ordered before (low, key_id), after the rest
+ */
+void SpanIndex::split(int t, int low, int key_id, int& before /*out*/,
+                      int& after /*out*/) {
+  if (t == kNull) {
+    before = kNull;
+    after = kNull;
+    return;
+  }
+  if (isBefore(t, low, key_id)) {
+    split(_entries[t].right, low, key_id, _entries[t].right, after);
+    before = t;
+  } else {
+    split(_entries[t].left, low, key_id, before, _entries[t].left);
+    after = t;
+  }
+  update(t);
+}
+
+void SpanIndex::collect(int t, int coord, Point span,
+                        std::vector<int>& ids) const {
+  if (t == kNull) return;
+  auto& entry = _entries[t];
+  if (entry.max_high <= span._x || entry.min_coord >= coord) return;
+
+  collect(entry.left, coord, span, ids);
+  // entries on the right start at or after entry
+  if (entry.span._x >= span._y) return;
+  if (entry.span._y > span._x && entry.coord < coord) {
+    ids.push_back(t);
+  }
+  collect(entry.right, coord, span, ids);
+}
+
+}  // namespace EDA_CHALLENGE_Q4
@@ -0,0 +1,79 @@
+#ifndef SPAN_INDEX
+#define SPAN_INDEX
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "../includes/Point.hpp"
+
+namespace EDA_CHALLENGE_Q4 {
+
+/**
+ * @brief Index of cell spans for neighbour queries of legalization. Every
+ * vcg_id owns at most one entry: its span [_x, _y) on one axis and its
+ * coordinate on the other axis. Entries form a treap ordered by span low,
+ * and every subtree keeps its max span high and min coordinate, so a query
+ * skips subtrees that can not overlap the span or are not before the
+ * coordinate. Entries live in a vector indexed by vcg_id, updates never
+ * allocate.
+ *
+ * Updates take O(log n) expected. A query is not O(log n + k): one entry of a
+ * subtree may overlap the span and another be before the coordinate, and
+ * then the subtree is walked with no match, so the worst case is O(n). Only
+ * the span low bounds the walk exactly. A pattern has at most 255 vcg_ids.
+ */
+class SpanIndex {
+ public:
+  // constructor
+  SpanIndex() : _root(kNull) {}
+  ~SpanIndex() = default;
+
+  // getter
+  bool isIndexed(int id) const;
+
+  // function
+  void resize(size_t id_num);
+  void insertSpan(int id, Point span, int coord);
+  void eraseSpan(int id);
+  void obtainBefore(int coord, Point span, std::vector<int>& ids) const;
+
+ private:
+  struct Entry {
+    Point span;
+    int coord;
+    uint32_t priority;
+    int left;
+    int right;
+    int max_high;   // of subtree
+    int min_coord;  // of subtree
+    bool indexed;
+  };
+
+  // function
+  bool isBefore(int id, int low, int key_id) const;
+  void update(int t);
+  int merge(int a, int b);
+  void split(int t, int low, int key_id, int& before, int& after);
+  void collect(int t, int coord, Point span, std::vector<int>& ids) const;
+
+  // members
+  static constexpr int kNull = -1;
+  std::vector<Entry> _entries;
+  int _root;
+};
+
+inline bool SpanIndex::isIndexed(int id) const {
+  return id >= 0 && (size_t)id < _entries.size() && _entries[id].indexed;
+}
+
+/* entries are ordered by (span low, id) */
+inline bool SpanIndex::isBefore(int id, int low, int key_id) const {
+  auto& entry = _entries[id];
+  return entry.span._x < low || (entry.span._x == low && id < key_id);
+}
+
+}  // namespace EDA_CHALLENGE_Q4
+
+#endif
@@ -0,0 +1,22 @@
+# run BIN on resources/CASE and compare output/result.txt with CASE/result.txt
+# usage: cmake -DBIN=... -DCASE=... -DWORK=... [-DARGS=...] -P check_result.cmake
+file(REMOVE_RECURSE ${WORK})
+file(MAKE_DIRECTORY ${WORK}/build ${WORK}/output)
+
+execute_process(
+  COMMAND ${BIN} -f${CASE}/configure.xml -s${CASE}/constraint.xml ${ARGS}
+  WORKING_DIRECTORY ${WORK}/build
+  RESULT_VARIABLE rc
+  OUTPUT_QUIET)
+if (NOT rc EQUAL 0)
+  message(FATAL_ERROR "${BIN} exited with ${rc}")
+endif()
+
+execute_process(
+  COMMAND ${CMAKE_COMMAND} -E compare_files --ignore-eol
+          ${CASE}/result.txt ${WORK}/output/result.txt
+  RESULT_VARIABLE diff)
+if (NOT diff EQUAL 0)
+  file(READ ${WORK}/output/result.txt result)
+  message(FATAL_ERROR "result.txt differs from ${CASE}/result.txt:\n${result}")
+endif()
@@ -10,24 +10,45 @@ CellManager::CellManager(ConfigManager* conf_man) {
   init_cells(kCellTypeSoc, conf_man->get_soc_list());
   init_mems_aux();
   init_socs_aux();  
+  init_classes();
 }
 
-static int id_deviate = 1000;
 /* initialize _mems or _socs */
-void CellManager::init_cells(CellType type, std::vector<Config*> configs) {
+void CellManager::init_cells(CellType type,
+                             const std::vector<Config*>& configs) {
   Cell* cell = nullptr;
   for (auto conf : configs) {
+    if (conf->get_amount() == 0) continue;
+
+    _class_first.push_back(_cells.size());
+    _class_amount.push_back(conf->get_amount());
     for (int i = 0; i < conf->get_amount(); ++i) {
       cell = new Cell();
       cell->set_width(conf->get_width());
       cell->set_height(conf->get_height());
       cell->set_refer(conf->get_refer());
       cell->set_cell_id(conf->get_id_refer() * id_deviate + i);
+      cell->set_index(_cells.size());
+      cell->set_class(_class_first.size() - 1);
       insert_cell(type, cell);
     }
   }
 }
 
+/* first cell of every class, grouped by cell type */
+void CellManager::init_classes() {
+  _mem_classes.clear();
+  _soc_classes.clear();
+  for (auto first : _class_first) {
+    auto cell = _cells[first];
+    if (cell->get_cell_type() == kCellTypeMem) {
+      _mem_classes.push_back(cell);
+    } else {
+      _soc_classes.push_back(cell);
+    }
+  }
+}
+
 std::vector<Cell*> CellManager::choose_cells(bool aux, CellPriority prio, ...) {
   va_list ap;
   va_start(ap, prio);
@@ -195,43 +216,53 @@ std::vector<Cell*> CellManager::get_min_area_sorted_chose_cells(
 }
 
 CellManager::~CellManager() {
-  for (auto m : _mems) {
-    delete m;
+  // cells picked out of _mems or _socs are released here as well
+  for (auto c : _cells) {
+    delete c;
   }
+  _cells.clear();
+  _shapes.clear();
+
   _mems.clear();
   _mems_aux.clear();
-
-  for (auto s : _socs) {
-    delete s;
-  }
   _socs.clear();
   _socs_aux.clear();
-
-  _id_map.clear();
+  _refer_offset.clear();
+  _class_first.clear();
+  _class_amount.clear();
+  _mem_classes.clear();
+  _soc_classes.clear();
 }
 
 CellManager::CellManager(const CellManager& man) {
-  ASSERT(man.get_mems_num() + man.get_socs_num() == man.get_id_map_num(), 
+  ASSERT(man.get_mems_num() + man.get_socs_num() == man.get_cells_num(), 
     "Please return cells into _mems and _socs before using copy constructor");
 
+  // same indexes as man
+  _cells.resize(man.get_cells_num());
+  for (auto c : man.get_cells()) {
+    _cells[c->get_index()] = new Cell(*c);
+  }
+  _shapes = man._shapes;
+  _refer_offset = man._refer_offset;
+  _class_first = man._class_first;
+  _class_amount = man._class_amount;
+
   size_t num = 0;
   _mems.resize(man.get_mems_num());
   for (auto c : man.get_mems()) {
-    auto new_cell = new Cell(*c);
-    _mems[num++] = new_cell;
-    _id_map[new_cell->get_cell_id()] = new_cell;
+    _mems[num++] = _cells[c->get_index()];
   }
 
   num = 0;
   _socs.resize(man.get_socs_num());
   for (auto c : man.get_socs()) {
-    auto new_cell = new Cell(*c);
-    _socs[num++] = new_cell;
-    _id_map[new_cell->get_cell_id()] = new_cell;
+    _socs[num++] = _cells[c->get_index()];
   }
 
   init_mems_aux();
   init_socs_aux();
+  init_classes();
 }
 
 int Cell::get_refer_id() { 
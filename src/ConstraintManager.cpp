@@ -1,120 +1,127 @@
 #include "ConstraintManager.hpp"
 namespace EDA_CHALLENGE_Q4 {
 
-ConstraintManager::ConstraintManager(Token_List& tokens) {
-  std::vector<RegexType> stack;  // maybe change to an uint8[] better
-  Constraint* constraint = nullptr;
-
-  for (auto token : tokens) {
-    switch (token.second) {
-      // skip
-      case kTAG_XML_HEAD:
-      case kTAG_DATA_BEG:
-      case kTAG_DATA_END:
-        break;
+void ConstraintManager::on_token(RegexType type, std::string_view text) {
+  switch (type) {
+    // skip
+    case kTAG_XML_HEAD:
+    case kTAG_DATA_BEG:
+    case kTAG_DATA_END:
+      break;
 
-      // constraint tag
-      case kTAG_CONSTRAINT_BEG:
-        stack.push_back(token.second);
-        constraint = new Constraint();
-        break;
-      case kTAG_CONSTRAINT_END:
-        assert(stack.back() == kTAG_CONSTRAINT_BEG);
-        stack.pop_back();
-        _pattern_list.push_back(constraint);
-        constraint = nullptr;
-        break;
+    // constraint tag
+    case kTAG_CONSTRAINT_BEG:
+      _stack.push_back(type);
+      _constraint = new Constraint();
+      break;
+    case kTAG_CONSTRAINT_END:
+      assert(_stack.back() == kTAG_CONSTRAINT_BEG);
+      _stack.pop_back();
+      if (_sink) {
+        _sink(_constraint);
+      } else {
+        _pattern_list.push_back(_constraint);
+      }
+      _constraint = nullptr;
+      break;
 
-      // pattern tag
-      case kTAG_PATTERN_BEG:
-        assert(stack.back() == kTAG_CONSTRAINT_BEG);
-        stack.push_back(token.second);
-        break;
-      case kTAG_PATTERN_END:
-        assert(stack.back() == kTAG_PATTERN_BEG);
-        stack.pop_back();
-        break;
+    // pattern tag
+    case kTAG_PATTERN_BEG:
+      assert(_stack.back() == kTAG_CONSTRAINT_BEG);
+      _stack.push_back(type);
+      break;
+    case kTAG_PATTERN_END:
+      assert(_stack.back() == kTAG_PATTERN_BEG);
+      _stack.pop_back();
+      break;
 
-      // push with constraint property tag
-      case kTAG_XMM_BEG:
-      case kTAG_YMM_BEG:
-      case kTAG_XSS_BEG:
-      case kTAG_YSS_BEG:
-      case kTAG_XMS_BEG:
-      case kTAG_YMS_BEG:
-      case kTAG_XMI_BEG:
-      case kTAG_YMI_BEG:
-      case kTAG_XSI_BEG:
-      case kTAG_YSI_BEG:
-        assert(stack.back() == kTAG_CONSTRAINT_BEG);
-        stack.push_back(token.second);
-        break;
+    // push with constraint property tag
+    case kTAG_XMM_BEG:
+    case kTAG_YMM_BEG:
+    case kTAG_XSS_BEG:
+    case kTAG_YSS_BEG:
+    case kTAG_XMS_BEG:
+    case kTAG_YMS_BEG:
+    case kTAG_XMI_BEG:
+    case kTAG_YMI_BEG:
+    case kTAG_XSI_BEG:
+    case kTAG_YSI_BEG:
+    case kTAG_BEAM_BEG:
+      assert(_stack.back() == kTAG_CONSTRAINT_BEG);
+      _stack.push_back(type);
+      break;
 
-      // pop with constraint property tag
-      case kTAG_XMM_END:
-        assert(stack.back() == kTAG_XMM_BEG);
-        stack.pop_back();
-        break;
-      case kTAG_YMM_END:
-        assert(stack.back() == kTAG_YMM_BEG);
-        stack.pop_back();
-        break;
-      case kTAG_XSS_END:
-        assert(stack.back() == kTAG_XSS_BEG);
-        stack.pop_back();
-        break;
-      case kTAG_YSS_END:
-        assert(stack.back() == kTAG_YSS_BEG);
-        stack.pop_back();
-        break;
-      case kTAG_XMS_END:
-        assert(stack.back() == kTAG_XMS_BEG);
-        stack.pop_back();
-        break;
-      case kTAG_YMS_END:
-        assert(stack.back() == kTAG_YMS_BEG);
-        stack.pop_back();
-        break;
-      case kTAG_XMI_END:
-        assert(stack.back() == kTAG_XMI_BEG);
-        stack.pop_back();
-        break;
-      case kTAG_YMI_END:
-        assert(stack.back() == kTAG_YMI_BEG);
-        stack.pop_back();
-        break;
-      case kTAG_XSI_END:
-        assert(stack.back() == kTAG_XSI_BEG);
-        stack.pop_back();
-        break;
-      case kTAG_YSI_END:
-        assert(stack.back() == kTAG_YSI_BEG);
-        stack.pop_back();
-        break;
+    // pop with constraint property tag
+    case kTAG_XMM_END:
+      assert(_stack.back() == kTAG_XMM_BEG);
+      _stack.pop_back();
+      break;
+    case kTAG_YMM_END:
+      assert(_stack.back() == kTAG_YMM_BEG);
+      _stack.pop_back();
+      break;
+    case kTAG_XSS_END:
+      assert(_stack.back() == kTAG_XSS_BEG);
+      _stack.pop_back();
+      break;
+    case kTAG_YSS_END:
+      assert(_stack.back() == kTAG_YSS_BEG);
+      _stack.pop_back();
+      break;
+    case kTAG_XMS_END:
+      assert(_stack.back() == kTAG_XMS_BEG);
+      _stack.pop_back();
+      break;
+    case kTAG_YMS_END:
+      assert(_stack.back() == kTAG_YMS_BEG);
+      _stack.pop_back();
+      break;
+    case kTAG_XMI_END:
+      assert(_stack.back() == kTAG_XMI_BEG);
+      _stack.pop_back();
+      break;
+    case kTAG_YMI_END:
+      assert(_stack.back() == kTAG_YMI_BEG);
+      _stack.pop_back();
+      break;
+    case kTAG_XSI_END:
+      assert(_stack.back() == kTAG_XSI_BEG);
+      _stack.pop_back();
+      break;
+    case kTAG_YSI_END:
+      assert(_stack.back() == kTAG_YSI_BEG);
+      _stack.pop_back();
+      break;
+    case kTAG_BEAM_END:
+      assert(_stack.back() == kTAG_BEAM_BEG);
+      _stack.pop_back();
+      break;
 
-      // set data
-      case kDATA:
-        if (stack.back() == kTAG_PATTERN_BEG) {
-          constraint->set_pattern(token.first);
-        } else {
-          constraint->set_constraint(stack.back(), token.first.c_str());
-        }
-        break;
+    // set data
+    case kDATA:
+      if (_stack.back() == kTAG_PATTERN_BEG) {
+        _constraint->set_pattern(text);
+      } else if (_stack.back() == kTAG_BEAM_BEG) {
+        _constraint->set_beam_width(pop_int(text));
+      } else {
+        _constraint->set_constraint(_stack.back(), text);
+      }
+      break;
 
-      // bugs
-      default:
-        PANIC("No operation tag: %s", token.first.c_str());
-        break;
-    }
+    // bugs
+    default:
+      PANIC("No operation tag: %s", std::string(text).c_str());
+      break;
   }
+}
 
-  ASSERT(stack.size() == 0, "Some tokens should be processed");
+void ConstraintManager::on_end() {
+  ASSERT(_stack.size() == 0, "Some tokens should be processed");
 }
 
-void Constraint::set_constraint(RegexType type, const char* data) {
-  uint16_t min;
-  uint16_t max;
-  sscanf(data, "%hd %hd", &min, &max);
+void Constraint::set_constraint(RegexType type, std::string_view data) {
+  uint16_t min = pop_int(data);
+  uint16_t max = pop_int(data);
   assert(min < max);
 
   switch (type) {
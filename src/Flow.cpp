@@ -1,11 +1,24 @@
 #include "Flow.hpp"
 
 #include <assert.h>
+#include <fcntl.h>
 #include <getopt.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
+#include "BoundedQueue.hpp"
 #include "VCG.hpp"
 
 namespace EDA_CHALLENGE_Q4 {
@@ -36,11 +49,26 @@ void Flow::doStepTask() {
 void Flow::doTaskParseArgv() {
   const struct option table[] = {{"cfg", required_argument, nullptr, 'f'},
                                  {"cst", required_argument, nullptr, 's'},
+                                 {"jobs", required_argument, nullptr, 'j'},
+                                 {"threads", required_argument, nullptr, 't'},
+                                 {"beam", required_argument, nullptr, 'b'},
+                                 {"adaptive", no_argument, nullptr, 'a'},
+                                 {"budget-pairs", required_argument, nullptr, 'p'},
+                                 {"budget-ms", required_argument, nullptr, 'm'},
+                                 {"lazy", no_argument, nullptr, 'l'},
+                                 {"no-legalize", no_argument, nullptr, 'n'},
+                                 {"stream", required_argument, nullptr, 'q'},
+                                 {"cache", required_argument, nullptr, 'c'},
                                  {"help", no_argument, nullptr, 'h'},
                                  {nullptr, 0, nullptr, 0}};
 
+  _jobs = 1;
+  _legalize = true;
+  _stream = 0;
+  _cache_file = nullptr;
   int option = 0;
-  while ((option = getopt_long(_argc, _argv, "-hf:s:", table, nullptr)) != -1) {
+  while ((option = getopt_long(_argc, _argv, "-hf:s:j:t:b:ap:m:lnq:c:", table,
+                               nullptr)) != -1) {
     switch (option) {
       case 'f':
         _config_file = optarg;
@@ -48,10 +76,59 @@ void Flow::doTaskParseArgv() {
       case 's':
         _constraint_file = optarg;
         break;
+      case 'j':
+        _jobs = std::max(1, atoi(optarg));
+        break;
+      case 't':
+        _search_config._threads = std::max(1, atoi(optarg));
+        break;
+      case 'b':
+        _search_config._beam_width = std::max(1, atoi(optarg));
+        break;
+      case 'a':
+        _search_config._adaptive = true;
+        break;
+      case 'p':
+        _search_config._pair_budget = std::max(0, atoi(optarg));
+        break;
+      case 'm':
+        _search_config._time_budget = std::max(0, atoi(optarg));
+        break;
+      case 'l':
+        _search_config._lazy = true;
+        break;
+      case 'n':
+        _legalize = false;
+        break;
+      case 'q':
+        _stream = std::max(1, atoi(optarg));
+        break;
+      case 'c':
+        _cache_file = optarg;
+        break;
       default:
         printf("Usage: %s [OPTION...] \n\n", _argv[0]);
         printf("\t-f,--cfg=FILE     input configure file\n");
         printf("\t-s,--cst=FILE     input constraint file\n");
+        printf("\t-j,--jobs=N       floorplan N patterns in parallel\n");
+        printf("\t-t,--threads=N    merge picks of a pattern on N threads\n");
+        printf("\t-b,--beam=N       keep N picks per pattern tree node,"
+               " <BEAM_WIDTH> of a pattern overrides it\n");
+        printf("\t-a,--adaptive     wider beam near root, narrower near"
+               " leaves, faster but narrow leaves may lose the only fit"
+               " picks (test2 gets NA instead of 240 * 270)\n");
+        printf("\t-p,--budget-pairs=N  stop merging a node when N pairs do"
+               " not improve it\n");
+        printf("\t-m,--budget-ms=N  stop merging a node when N ms do not"
+               " improve it\n");
+        printf("\t-l,--lazy         merge pairs of a node best-first on one"
+               " thread\n");
+        printf("\t-n,--no-legalize  keep cells where the search placed them,"
+               " do not solve spacing rules\n");
+        printf("\t-q,--stream=N     floorplan patterns while constraint file"
+               " is parsed, at most N parsed patterns or outputs wait\n");
+        printf("\t-c,--cache=FILE   load both xml files from FILE if it"
+               " matches them, else write it, not used with -q\n");
         printf("\n");
         exit(0);
         break;
@@ -60,69 +137,289 @@ void Flow::doTaskParseArgv() {
 }
 
 void Flow::doTaskParseResources() {
+  auto start = std::chrono::steady_clock::now();
   // parse xml
-  _parser = new Regex(kXML);
-  parseXml(_config_file);
-  _conf_man = new ConfigManager(_parser->get_tokens());
-  parseXml(_constraint_file);
-  _constraint_man = new ConstraintManager(_parser->get_tokens());
+  _conf_man = new ConfigManager();
+  _constraint_man = new ConstraintManager();
+  size_t bytes = 0;
+  if (_cache_file != nullptr && _stream == 0) {
+    ProblemCache cache(_cache_file);
+    auto hash = ProblemCache::hash_inputs(_config_file, _constraint_file);
+    if (cache.load(hash, _conf_man, _constraint_man)) {
+      g_log << "[cache] hit " << _cache_file << "\n";
+    } else {
+      bytes = parseProblem();
+      bool saved = cache.save(hash, _conf_man, _constraint_man);
+      g_log << "[cache] miss " << _cache_file
+            << (saved ? ", saved\n" : ", can not save\n");
+    }
+  } else {
+    bytes = parseProblem();
+  }
   _cell_man = new CellManager(_conf_man);
+
+  std::chrono::duration<double> sec = std::chrono::steady_clock::now() - start;
+  g_log << "[parse] " << bytes << " bytes, time = " << sec.count() * 1e3
+        << " ms, " << (sec.count() > 0 ? bytes / 1e6 / sec.count() : 0)
+        << " MB/s\n";
+  g_log.flush();
+}
+
+/**
+ * @brief parse configure file, and constraint file unless it is streamed
+ *
+ * @return bytes parsed
+ */
+size_t Flow::parseProblem() {
+  _parser = new Regex(kXML);
+  _parser->set_handler(_conf_man);
+  size_t bytes = parseXml(_config_file);
+  if (_stream == 0) {  // or parsed by floorplan_stream()
+    _parser->set_handler(_constraint_man);
+    bytes += parseXml(_constraint_file);
+  }
   delete _parser;
   _parser = nullptr;
+  return bytes;
 }
 
-void Flow::parseXml(char* file) {
-  FILE* fp = fopen(file, "r");
-  assert(fp != nullptr && _parser != nullptr);
+/**
+ * @brief tokenize file in place into the handler of _parser. Regular files
+ * are mapped, others like pipes are read into a buffer.
+ *
+ * @return bytes of file
+ */
+size_t Flow::parseXml(char* file) {
+  assert(_parser != nullptr);
+  int fd = open(file, O_RDONLY);
+  ASSERT(fd >= 0, "Can not open %s", file);
+  struct stat st;
+  ASSERT(fstat(fd, &st) == 0, "Can not stat %s", file);
 
   _parser->reset_tokens();
-  const uint16_t buffer_size = 256;
-  char buffer[buffer_size];
-  while (!feof(fp)) {
-    memset(buffer, 0, buffer_size);
-    if (fgets(buffer, buffer_size, fp) == nullptr) {
-      continue;
+  size_t size = st.st_size;
+  void* addr = MAP_FAILED;
+  if (S_ISREG(st.st_mode) && size > 0) {
+    addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  if (addr != MAP_FAILED) {
+    madvise(addr, size, MADV_SEQUENTIAL);
+    auto data = (const char*)addr;
+    _parser->make_tokens(data, data + size);
+    munmap(addr, size);
+  } else {
+    std::string buffer;
+    char chunk[1 << 16];
+    ssize_t num;
+    while ((num = read(fd, chunk, sizeof(chunk))) > 0) {
+      buffer.append(chunk, num);
     }
-    //
-    _parser->make_tokens(buffer);
+    ASSERT(num == 0, "Can not read %s", file);
+    size = buffer.size();
+    _parser->make_tokens(buffer.data(), buffer.data() + size);
   }
-  fclose(fp);
+  close(fd);
+  return size;
 }
 
 void Flow::doTaskFloorplan() {
-  // parse pattern to VCG
-  _parser = new Regex(kPATTERN);
-  for (auto constraint : _constraint_man->get_pattern_list()) {
-    g_log << "\n## " << constraint->get_pattern() << " >>\n";
-    g_log.flush();
-
-    _parser->make_tokens(const_cast<char*>(constraint->get_pattern().c_str()));
-    VCG g(_parser->get_tokens());
-    g.set_cell_man(_cell_man);
-    g.set_constraint(constraint);
-    // // !!!!! floorplan >>>>> !!!!!
-    g.find_best_place();
-    // // !!!!! <<<<< floorplan !!!!!
-    g.gen_GDS();
-
-    _parser->reset_tokens();
-
-    // do cell movement.
-    // CellMovement* cell_move = new CellMovement(&g);
-    // cell_move->executeCellMovement();
-    // delete cell_move;
-
-    ++g._gds_file_num;
-    g.gen_result();
-
-    g_log << " << end\n";
-    g_log.flush();
-
-    // g.gen_result();
+  std::fstream result("../output/result.txt", std::ios::app | std::ios::out);
+  assert(result.is_open());
+
+  if (_stream) {
+    floorplan_stream(result);
+  } else if (_jobs > 1) {
+    floorplan_parallel(result);
+  } else {
+    // parse pattern to VCG
+    _parser = new Regex(kPATTERN);
+    auto& pattern_list = _constraint_man->get_pattern_list();
+    for (size_t i = 0; i < pattern_list.size(); ++i) {
+      floorplan(_parser, pattern_list[i], i, result);
+    }
+
+    delete _parser;
+    _parser = nullptr;
   }
 
+  result.close();
+}
+
+/**
+ * @brief floorplan one pattern, the only data shared with other patterns is
+ * _cell_man, which is copied by VCG and never changed.
+ *
+ * @param parser      pattern parser owned by caller
+ * @param constraint  pattern to floorplan
+ * @param index       index of the pattern in constraint.xml
+ * @param result      where result of this pattern is written
+ */
+void Flow::floorplan(Regex* parser, Constraint* constraint, size_t index,
+                     std::ostream& result) {
+  g_log << "\n## " << constraint->get_pattern() << " >>\n";
+  g_log.flush();
+
+  parser->make_tokens(constraint->get_pattern().c_str());
+  VCG g(parser->get_tokens());
+  g.set_cell_man(_cell_man);
+  g.set_constraint(constraint);
+  g.set_gds_file_num(index);
+  auto config = _search_config;
+  if (constraint->get_beam_width()) {
+    config._beam_width = constraint->get_beam_width();
+  }
+  g.set_search_config(config);
+  // // !!!!! floorplan >>>>> !!!!!
+  g.find_best_place();
+  // // !!!!! <<<<< floorplan !!!!!
+  if (_legalize) {
+    DifferenceConstraintLegalizer legalizer(&g);
+    legalizer.executeLegalization();
+  }
+  g.gen_GDS();
+
+  parser->reset_tokens();
+
+  g.gen_result(result);
+
+  g_log << " << end\n";
+  g_log.flush();
+}
+
+/**
+ * @brief floorplan patterns with _jobs threads. Each worker collects log and
+ * result of a pattern in its own buffers, and buffers are committed in the
+ * order of constraint.xml, so that outputs are the same as serial ones.
+ *
+ * @param result  result file
+ */
+void Flow::floorplan_parallel(std::ostream& result) {
+  auto& pattern_list = _constraint_man->get_pattern_list();
+  const size_t num = pattern_list.size();
+
+  std::vector<std::string> logs(num);
+  std::vector<std::string> results(num);
+  std::vector<bool> finished(num, false);
+  size_t commit = 0;  // patterns before it have been written
+  std::mutex commit_mutex;
+  std::atomic<size_t> next(0);
+  std::ostream& log = g_log;  // g_log of main thread
+
+  auto worker = [&]() {
+    Regex parser(kPATTERN);
+    for (size_t i = next++; i < num; i = next++) {
+      std::stringbuf log_buf;
+      std::ostringstream result_buf;
+      auto origin_buf = log_redirect(&log_buf);
+      floorplan(&parser, pattern_list[i], i, result_buf);
+      log_redirect(origin_buf);
+
+      std::lock_guard<std::mutex> lock(commit_mutex);
+      logs[i] = log_buf.str();
+      results[i] = result_buf.str();
+      finished[i] = true;
+      for (; commit < num && finished[commit]; ++commit) {
+        log << logs[commit];
+        result << results[commit];
+        std::string().swap(logs[commit]);
+        std::string().swap(results[commit]);
+      }
+      log.flush();
+      result.flush();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < _jobs && (size_t)i < num; ++i) {
+    workers.emplace_back(worker);
+  }
+  for (auto& t : workers) {
+    t.join();
+  }
+  ASSERT(commit == num, "Some patterns have not been committed");
+}
+
+/**
+ * @brief parse constraint.xml while _jobs workers floorplan its patterns.
+ * Parsed patterns wait in a queue of _stream, so parsing stalls when workers
+ * fall behind, and a pattern is freed once it is floorplanned. Outputs are
+ * committed in order like floorplan_parallel(). At most _stream outputs wait
+ * behind a slow pattern, then workers wait for it too.
+ *
+ * @param result  result file
+ */
+void Flow::floorplan_stream(std::ostream& result) {
+  typedef std::pair<size_t, Constraint*> Item;  // index in constraint.xml
+  BoundedQueue<Item> queue(_stream);
+  // log and result of patterns finished before earlier ones
+  std::map<size_t, std::pair<std::string, std::string>> pending;
+  size_t commit = 0;  // patterns before it have been written
+  std::mutex commit_mutex;
+  std::condition_variable committed;
+  std::ostream& log = g_log;  // g_log of main thread
+  auto start = std::chrono::steady_clock::now();
+  auto ms_since_start = [start]() {
+    std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - start;
+    return ms.count();
+  };
+  double first_ms = 0;
+
+  auto worker = [&]() {
+    Regex parser(kPATTERN);
+    Item item;
+    while (queue.pop(item)) {
+      std::stringbuf log_buf;
+      std::ostringstream result_buf;
+      auto origin_buf = log_redirect(&log_buf);
+      floorplan(&parser, item.second, item.first, result_buf);
+      log_redirect(origin_buf);
+      delete item.second;
+
+      std::unique_lock<std::mutex> lock(commit_mutex);
+      // the worker of pattern commit never waits, so this ends
+      committed.wait(lock, [&]() {
+        return item.first == commit || pending.size() < (size_t)_stream;
+      });
+      pending[item.first] = {log_buf.str(), result_buf.str()};
+      for (auto it = pending.begin();
+           it != pending.end() && it->first == commit; ++commit) {
+        log << it->second.first;
+        result << it->second.second;
+        it = pending.erase(it);
+      }
+      committed.notify_all();
+      if (first_ms == 0 && commit) first_ms = ms_since_start();
+      log.flush();
+      result.flush();
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 0; i < _jobs; ++i) {
+    workers.emplace_back(worker);
+  }
+
+  size_t num = 0;
+  _constraint_man->set_sink([&](Constraint* c) { queue.push({num++, c}); });
+  _parser = new Regex(kXML);
+  _parser->set_handler(_constraint_man);
+  size_t bytes = parseXml(_constraint_file);
+  double parse_ms = ms_since_start();
   delete _parser;
   _parser = nullptr;
+  queue.close();
+
+  for (auto& t : workers) {
+    t.join();
+  }
+  ASSERT(commit == num && pending.empty(),
+         "Some patterns have not been committed");
+
+  log << "[stream] patterns = " << num << ", bytes = " << bytes
+      << ", parse = " << parse_ms << " ms, first result = " << first_ms
+      << " ms, total = " << ms_since_start() << " ms\n";
+  log.flush();
 }
 
-}  // namespace EDA_CHALLENGE_Q4
\ No newline at end of file
+}  // namespace EDA_CHALLENGE_Q4
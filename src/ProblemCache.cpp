@@ -0,0 +1,196 @@
+#include "ProblemCache.hpp"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace EDA_CHALLENGE_Q4 {
+
+static constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+static constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+template <typename T>
+static void put(std::string& buf /*out*/, T value) {
+  buf.append((const char*)&value, sizeof(T));
+}
+
+/**
+ * @return false if fewer than sizeof(T) bytes are left
+ */
+template <typename T>
+static bool get(const char*& pos /*in,out*/, const char* end,
+                T& value /*out*/) {
+  if ((size_t)(end - pos) < sizeof(T)) return false;
+  memcpy(&value, pos, sizeof(T));
+  pos += sizeof(T);
+  return true;
+}
+
+static bool get_text(const char*& pos /*in,out*/, const char* end, size_t len,
+                     std::string_view& text /*out*/) {
+  if ((size_t)(end - pos) < len) return false;
+  text = std::string_view(pos, len);
+  pos += len;
+  return true;
+}
+
+/**
+ * @brief FNV-1a of both files, each followed by its length so contents can
+ * not shift between them
+ */
+uint64_t ProblemCache::hash_inputs(const char* config_file,
+                                   const char* constraint_file) {
+  uint64_t hash = hash_file(config_file, kFnvOffset);
+  return hash_file(constraint_file, hash);
+}
+
+uint64_t ProblemCache::hash_file(const char* file, uint64_t hash) {
+  int fd = open(file, O_RDONLY);
+  if (fd < 0) return hash;  // reported by the xml parser later
+
+  char buf[1 << 16];
+  uint64_t len = 0;
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0) {
+    for (ssize_t i = 0; i < n; ++i) {
+      hash = (hash ^ (uint8_t)buf[i]) * kFnvPrime;
+    }
+    len += n;
+  }
+  close(fd);
+  for (int i = 0; i < 8; ++i) {
+    hash = (hash ^ (uint8_t)(len >> (i * 8))) * kFnvPrime;
+  }
+  return hash;
+}
+
+/**
+ * @brief fill empty managers from the cache file
+ *
+ * @return false, managers untouched, if the file is missing, of another
+ * version or hash, or truncated
+ */
+bool ProblemCache::load(uint64_t hash, ConfigManager* conf_man /*out*/,
+                        ConstraintManager* cst_man /*out*/) {
+  int fd = open(_path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+    close(fd);
+    return false;
+  }
+  size_t size = st.st_size;
+  void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED) return false;
+
+  const char* pos = (const char*)addr;
+  const char* end = pos + size;
+  char magic[sizeof(_magic)];
+  uint32_t version, reserved, mem_num, soc_num, constraint_num;
+  uint64_t file_hash;
+  bool ok = get(pos, end, magic) &&
+            memcmp(magic, _magic, sizeof(_magic)) == 0 &&
+            get(pos, end, version) && version == _version &&
+            get(pos, end, reserved) && get(pos, end, file_hash) &&
+            file_hash == hash && get(pos, end, mem_num) &&
+            get(pos, end, soc_num) && get(pos, end, constraint_num);
+
+  // built aside first, a bad file leaves managers as they were
+  std::vector<std::pair<CellType, Config*>> configs;
+  for (uint64_t i = 0; ok && i < (uint64_t)mem_num + soc_num; ++i) {
+    uint8_t id_refer;
+    uint16_t amount, width, height, refer_len;
+    std::string_view refer;
+    ok = get(pos, end, id_refer) && get(pos, end, amount) &&
+         get(pos, end, width) && get(pos, end, height) &&
+         get(pos, end, refer_len) && get_text(pos, end, refer_len, refer);
+    if (!ok) break;
+    auto conf = new Config(id_refer, amount, width, height);
+    conf->set_refer(refer);
+    configs.push_back({i < mem_num ? kCellTypeMem : kCellTypeSoc, conf});
+  }
+
+  std::vector<Constraint*> constraints;
+  for (uint32_t i = 0; ok && i < constraint_num; ++i) {
+    uint16_t beam_width;
+    uint16_t values[kTotal];
+    uint32_t pattern_len;
+    std::string_view pattern;
+    ok = get(pos, end, beam_width) && get(pos, end, values) &&
+         get(pos, end, pattern_len) && get_text(pos, end, pattern_len, pattern);
+    if (!ok) break;
+    auto constraint = new Constraint();
+    constraint->set_beam_width(beam_width);
+    for (int type = 0; type < kTotal; ++type) {
+      constraint->set_constraint((ConstraintType)type, values[type]);
+    }
+    constraint->set_pattern(pattern);
+    constraints.push_back(constraint);
+  }
+  ok = ok && pos == end;
+  munmap(addr, size);
+
+  if (!ok) {
+    for (auto& conf : configs) delete conf.second;
+    for (auto constraint : constraints) delete constraint;
+    return false;
+  }
+  for (auto& conf : configs) conf_man->add_config(conf.first, conf.second);
+  for (auto constraint : constraints) cst_man->add_constraint(constraint);
+  return true;
+}
+
+/**
+ * @brief write the managers to the cache file, by renaming a temporary file
+ * so readers never see a partial one
+ *
+ * @return false if the file can not be written
+ */
+bool ProblemCache::save(uint64_t hash, const ConfigManager* conf_man,
+                        const ConstraintManager* cst_man) const {
+  auto& mem_list = conf_man->get_mem_list();
+  auto& soc_list = conf_man->get_soc_list();
+  auto& pattern_list = cst_man->get_pattern_list();
+
+  std::string buf;
+  buf.append(_magic, sizeof(_magic));
+  put(buf, _version);
+  put(buf, (uint32_t)0);
+  put(buf, hash);
+  put(buf, (uint32_t)mem_list.size());
+  put(buf, (uint32_t)soc_list.size());
+  put(buf, (uint32_t)pattern_list.size());
+  for (auto list : {&mem_list, &soc_list}) {
+    for (auto conf : *list) {
+      put(buf, (uint8_t)conf->get_id_refer());
+      put(buf, (uint16_t)conf->get_amount());
+      put(buf, (uint16_t)conf->get_width());
+      put(buf, (uint16_t)conf->get_height());
+      put(buf, (uint16_t)conf->get_refer().size());
+      buf.append(conf->get_refer());
+    }
+  }
+  for (auto constraint : pattern_list) {
+    put(buf, (uint16_t)constraint->get_beam_width());
+    for (int type = 0; type < kTotal; ++type) {
+      put(buf, (uint16_t)constraint->get_cst((ConstraintType)type));
+    }
+    put(buf, (uint32_t)constraint->get_pattern().size());
+    buf.append(constraint->get_pattern());
+  }
+
+  std::string tmp_path = _path + ".tmp";
+  FILE* fp = fopen(tmp_path.c_str(), "wb");
+  if (fp == nullptr) return false;
+  bool ok = fwrite(buf.data(), 1, buf.size(), fp) == buf.size();
+  ok = fclose(fp) == 0 && ok;
+  ok = ok && rename(tmp_path.c_str(), _path.c_str()) == 0;
+  if (!ok) remove(tmp_path.c_str());
+  return ok;
+}
+
+}  // namespace EDA_CHALLENGE_Q4
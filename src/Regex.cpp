@@ -1,70 +1,244 @@
 #include "Regex.hpp"
 
 namespace EDA_CHALLENGE_Q4 {
-Regex::Regex(RegexMode mode) {
+
+/* xml tags with known names, matched by their full text */
+static const struct TagRule {
+  std::string tag;
+  RegexType token_type;
+} xml_tags[] = {
+    {"<data>", kTAG_DATA_BEG},
+    {"</data>", kTAG_DATA_END},
+    // config tag beg
+    {"<MEM>", kTAG_MEM_BEG},
+    {"<SOC>", kTAG_SOC_BEG},
+    {"<REFERENCE>", kTAG_REFERENCE_BEG},
+    {"<AMOUNT>", kTAG_AMOUNT_BEG},
+    {"<WIDTH>", kTAG_WIDTH_BEG},
+    {"<HEIGHT>", kTAG_HEIGHT_BEG},
+    {"</REFERENCE>", kTAG_REFERENCE_END},
+    {"</AMOUNT>", kTAG_AMOUNT_END},
+    {"</WIDTH>", kTAG_WIDTH_END},
+    {"</HEIGHT>", kTAG_HEIGHT_END},
+    {"</SOC>", kTAG_SOC_END},
+    {"</MEM>", kTAG_MEM_END},
+    // config tag end
+    // constraint tag beg
+    {"<CONSTRAINT>", kTAG_CONSTRAINT_BEG},
+    {"<PATTERN>", kTAG_PATTERN_BEG},
+    {"<SPACING_X_MEM_MEM>", kTAG_XMM_BEG},
+    {"<SPACING_Y_MEM_MEM>", kTAG_YMM_BEG},
+    {"<SPACING_X_SOC_SOC>", kTAG_XSS_BEG},
+    {"<SPACING_Y_SOC_SOC>", kTAG_YSS_BEG},
+    {"<SPACING_X_MEM_SOC>", kTAG_XMS_BEG},
+    {"<SPACING_Y_MEM_SOC>", kTAG_YMS_BEG},
+    {"<SPACING_X_MEM_INTERPOSER>", kTAG_XMI_BEG},
+    {"<SPACING_Y_MEM_INTERPOSER>", kTAG_YMI_BEG},
+    {"<SPACING_X_SOC_INTERPOSER>", kTAG_XSI_BEG},
+    {"<SPACING_Y_SOC_INTERPOSER>", kTAG_YSI_BEG},
+    {"<BEAM_WIDTH>", kTAG_BEAM_BEG},
+    {"</CONSTRAINT>", kTAG_CONSTRAINT_END},
+    {"</PATTERN>", kTAG_PATTERN_END},
+    {"</SPACING_X_MEM_MEM>", kTAG_XMM_END},
+    {"</SPACING_Y_MEM_MEM>", kTAG_YMM_END},
+    {"</SPACING_X_SOC_SOC>", kTAG_XSS_END},
+    {"</SPACING_Y_SOC_SOC>", kTAG_YSS_END},
+    {"</SPACING_X_MEM_SOC>", kTAG_XMS_END},
+    {"</SPACING_Y_MEM_SOC>", kTAG_YMS_END},
+    {"</SPACING_X_MEM_INTERPOSER>", kTAG_XMI_END},
+    {"</SPACING_Y_MEM_INTERPOSER>", kTAG_YMI_END},
+    {"</SPACING_X_SOC_INTERPOSER>", kTAG_XSI_END},
+    {"</SPACING_Y_SOC_INTERPOSER>", kTAG_YSI_END},
+    {"</BEAM_WIDTH>", kTAG_BEAM_END},
+    // constraint tag end
+};
+
+static const char kHorizontal[] = "&#60;";
+
+/* characters that make "\b" match before them */
+static inline bool is_word_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+         (c >= '0' && c <= '9') || c == '_';
+}
+
+/* length of the prefix of [str, end) made of chars in accepts */
+static size_t span_in(const char* str, const char* end, const char* accepts) {
+  const char* p = str;
+  while (p < end && *p != '\0' && strchr(accepts, *p)) ++p;
+  return p - str;
+}
+
+/* length of the prefix of [str, end) made of chars not in rejects */
+static size_t span_out(const char* str, const char* end, const char* rejects) {
+  const char* p = str;
+  while (p < end && !strchr(rejects, *p)) ++p;
+  return p - str;
+}
+
+/* length of the prefix of [str, end) without '<' and '>', hot in kDATA */
+static size_t span_text(const char* str, const char* end) {
+  const char* p = str;
+  while (p < end && *p != '<' && *p != '>') ++p;
+  return p - str;
+}
+
+/**
+ * @brief length of "<" + run + ">" for the longest run without any of stops,
+ * 0 if there is no such ">"
+ */
+static size_t match_tag_body(const char* str, const char* end,
+                             const char* stops) {
+  size_t run = span_out(str + 1, end, stops);
+  for (size_t len = run; len > 0; --len) {
+    if (str[len] == '>') return len + 1;
+  }
+  return 0;
+}
+
+Regex::Regex(RegexMode mode) : _handler(nullptr) {
   ASSERT(mode != kMODE_NULL, "Regex Mode should not be null!");
   set_mode(mode);
-  switch (mode) {
-    case kXML:
-      set_rules(xml_rules);
-      set_num_regex(sizeof(xml_rules) / sizeof(xml_rules[0]));
-      break;
-    case kPATTERN:
-      set_rules(pattern_rules);
-      set_num_regex(sizeof(pattern_rules) / sizeof(pattern_rules[0]));
-      break;
-    default:
-      assert(0);
-  }
-  init_mode();
 }
 
-bool Regex::make_tokens(char* buff) {
+bool Regex::make_tokens(const char* buff) {
   if (buff == nullptr) return false;
-  trim_nr(buff);
-
-  int i;
-  int position = 0;
-  regmatch_t pos_match;  // position of match
-
-  while (buff[position] != '\0') {
-    // Try all runles one by one
-    for (i = 0; i < _num_regex; ++i) {
-      if (regexec(&_regexs[i], buff + position, 1, &pos_match, 0) == 0 &&
-          pos_match.rm_so == 0) {
-        char* sub_str_star = buff + position;
-        position += pos_match.rm_eo;
-
-        switch (_rules[i].token_type) {
-          case kRegex_NULL:
-            PANIC("\"%s\" should not match kRegex_NULL",
-                  std::string(buff + position, pos_match.rm_so).c_str());
-            break;
-          case kSPACE:
-            break;
-          case kTAG_BEG:
-          case kTAG_END:
-            PANIC("Unknown tag: %s",
-                  std::string(sub_str_star, pos_match.rm_eo).c_str());
-            break;
-          default:
-            _tokens.push_back({std::string(sub_str_star, pos_match.rm_eo),
-                               _rules[i].token_type});
-            break;
-        }
+  return make_tokens(buff, buff + strlen(buff));
+}
 
-        break;
-      }
+/**
+ * @brief tokenize [begin, end) line by line, tokens never cross lines. The
+ * text is read in place, so it can be a mapped file without '\0'. With a
+ * handler, [begin, end) should be a whole file.
+ *
+ * @return false if some line has text that matches no rule
+ */
+bool Regex::make_tokens(const char* begin, const char* end) {
+  bool matched = true;
+  while (begin < end) {
+    auto line_end = (const char*)memchr(begin, '\n', end - begin);
+    auto next = line_end ? line_end + 1 : end;
+    if (line_end == nullptr) line_end = end;
+    // '\r' and '\n' can not be matched, remove them at the end of line
+    while (line_end > begin && (line_end[-1] == '\r' || line_end[-1] == '\n')) {
+      --line_end;
     }
+    matched = make_line_tokens(begin, line_end) && matched;
+    begin = next;
+  }
+  if (_handler) {
+    _handler->on_end();
+  }
+  return matched;
+}
 
-    if (i == _num_regex) {
-      printf("no match at position %d\n%s\n%*.s^\n", position, buff, position,
-             "");
-      return false;
+bool Regex::make_line_tokens(const char* line, const char* end) {
+  size_t position = 0;
+  size_t len = 0;
+  while (line + position < end) {
+    const char* sub_str_star = line + position;
+    auto type = _mode == kXML ? match_xml(sub_str_star, end, len)
+                              : match_pattern(sub_str_star, end, len);
+
+    switch (type) {
+      case kRegex_NULL:
+        printf("no match at position %zu\n%.*s\n%*.s^\n", position,
+               (int)(end - line), line, (int)position, "");
+        return false;
+      case kSPACE:
+        break;
+      case kTAG_BEG:
+      case kTAG_END:
+        PANIC("Unknown tag: %s", std::string(sub_str_star, len).c_str());
+        break;
+      default:
+        if (_handler) {
+          _handler->on_token(type, std::string_view(sub_str_star, len));
+        } else {
+          _tokens.emplace_back(std::string(sub_str_star, len), type);
+        }
+        break;
     }
+    position += len;
   }
 
   return true;
 }
 
-}  // namespace EDA_CHALLENGE_Q4
\ No newline at end of file
+/**
+ * @brief token at the beginning of [str, end)
+ *
+ * @param str  not empty, no '\n' before end
+ * @param len  length of token
+ * @return kRegex_NULL if nothing matches
+ */
+RegexType Regex::match_xml(const char* str /*in*/, const char* end /*in*/,
+                           size_t& len /*out*/) {
+  size_t rest = end - str;
+  if (*str == ' ') {
+    len = span_in(str, end, " ");
+    return kSPACE;
+  }
+  if (is_word_char(*str)) {
+    len = span_text(str, end);
+    return kDATA;
+  }
+  if (*str != '<' || rest < 2) return kRegex_NULL;
+
+  if (str[1] == '?') {
+    size_t body = span_in(str + 2, end, "abcdefghijklmnopqrstuvwxyz0123456789 =\".");
+    if (body && body + 4 <= rest && str[2 + body] == '?' &&
+        str[3 + body] == '>') {
+      len = body + 4;
+      return kTAG_XML_HEAD;
+    }
+    return kRegex_NULL;
+  }
+
+  // known tag
+  size_t run = span_text(str + 1, end);
+  if (run + 1 < rest && str[run + 1] == '>') {
+    len = run + 2;
+    for (auto& rule : xml_tags) {
+      if (rule.tag.size() == len && memcmp(rule.tag.data(), str, len) == 0) {
+        return rule.token_type;
+      }
+    }
+  }
+
+  // unknown tag
+  if ((len = match_tag_body(str, end, "<?/"))) return kTAG_BEG;
+  if (str[1] == '/' && (len = match_tag_body(str + 1, end, "<?/"))) {
+    ++len;
+    return kTAG_END;
+  }
+  return kRegex_NULL;
+}
+
+RegexType Regex::match_pattern(const char* str /*in*/, const char* end /*in*/,
+                               size_t& len /*out*/) {
+  len = 1;
+  switch (*str) {
+    case ' ':
+      len = span_in(str, end, " ");
+      return kSPACE;
+    case '^':
+      return kVERTICAL;
+    case 'S':
+      return kSOC;
+    case 'M':
+      return kMEM;
+    case '|':
+      return kColumn;
+    case '&':
+      if ((size_t)(end - str) >= sizeof(kHorizontal) - 1 &&
+          memcmp(str, kHorizontal, sizeof(kHorizontal) - 1) == 0) {
+        len = sizeof(kHorizontal) - 1;
+        return kHORIZONTAL;
+      }
+      return kRegex_NULL;
+    default:
+      return kRegex_NULL;
+  }
+}
+
+}  // namespace EDA_CHALLENGE_Q4
@@ -1,14 +1,24 @@
 #include "VCG.hpp"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <limits>
+#include <thread>
+#include <tuple>
 
 namespace EDA_CHALLENGE_Q4 {
 
-size_t VCG::_gds_file_num = 0;
-static constexpr size_t max_combination = 80;
+thread_local ObjectPool* PickHelper::_pool = nullptr;
+thread_local ObjectPool* PickHelper::_data_pool = nullptr;
 
-VCG::VCG(Token_List& tokens) : _cm(nullptr), _cst(nullptr), _helper(nullptr) {
+VCG::VCG(Token_List& tokens)
+    : _cm(nullptr),
+      _cst(nullptr),
+      _helper(nullptr),
+      _gds_file_num(0),
+      _infeasible(false) {
   _adj_list.push_back(new VCGNode(kVCG_END));
   VCGNode* start = new VCGNode(kVCG_START);
 
@@ -236,12 +246,23 @@ void VCG::fill_id_grid() {
 }
 
 void VCG::find_best_place() {
+  if (is_topology_infeasible()) {
+    _infeasible = true;
+    g_log << "[precheck] infeasible pattern, traversal skipped\n";
+    g_log.flush();
+    return;
+  }
   traverse_tree();
   // root
   auto root = _tree->get_pt_node(0);
   ASSERT(root, "Root of Pattern Tree missing");
-  auto root_picks = root->get_picks();
-  ASSERT(root_picks.size(), "No Picks in root node");
+  auto& root_picks = root->get_picks();
+  if (root_picks.empty()) {
+    _infeasible = true;
+    g_log << "[search] no picks in root node\n";
+    g_log.flush();
+    return;
+  }
   auto best = root_picks[root_picks.size() - 1];
   set_cells_by_helper(best);
 
@@ -257,10 +278,7 @@ void VCG::find_best_place() {
   // }
 }
 
-void VCG::gen_result() {
-  std::fstream result("../output/result.txt", std::ios::app | std::ios::out);
-  assert(result.is_open());
-
+void VCG::gen_result(std::ostream& result) {
   std::string pattern = _cst->get_pattern();
   std::string::size_type pos = 0;
   const std::string sub_str = "&#60;";
@@ -275,7 +293,7 @@ void VCG::gen_result() {
 
   int c3_arr[4];
   get_interposer_c3(c3_arr);
-  if (c3_arr[0] > c3_arr[1] || c3_arr[2] > c3_arr[3]) {
+  if (_infeasible || c3_arr[0] > c3_arr[1] || c3_arr[2] > c3_arr[3]) {
     result << "NA\n";
   } else {
     result << c3_arr[0] << " * " << c3_arr[2] << "\n";
@@ -292,25 +310,61 @@ void VCG::gen_result() {
     }
   }
   result << "\n";
-
-  result.close();
 }
 
 void VCG::init_pattern_tree() {
   auto map = make_id_type_map();
-  _tree = new PatternTree(_id_grid, map);
+
+  // row-major copy of _id_grid, PTNodes keep views of it
+  auto cols = _id_grid.size();
+  auto rows = get_max_row(_id_grid);
+  _flat_grid.resize(cols * rows);
+  for (size_t col = 0; col < cols; ++col) {
+    ASSERT(_id_grid[col].size() == rows, "Fill grid first");
+    for (size_t row = 0; row < rows; ++row) {
+      _flat_grid[row * cols + col] = _id_grid[col][row];
+    }
+  }
+
+  _tree = new PatternTree(GridView(_flat_grid.data(), cols, rows), map);
   _tree->set_vcg(this);
 }
 
-PatternTree::PatternTree(GridType& grid, std::map<uint8_t, VCGNodeType>& map)
-    : _cm(nullptr), _cst(nullptr), _vcg(nullptr) {
+PatternTree::PatternTree(const GridView& grid,
+                         std::map<uint8_t, VCGNodeType>& map)
+    : _cm(nullptr),
+      _cst(nullptr),
+      _vcg(nullptr),
+      _slots(count_slots(map)),
+      _classes(0),
+      _same_num(0),
+      _config() {
   slice(grid, map);
   // debug_show_pt_grid_map();
+
+  // sides of interposer are sides of root grid
+  ASSERT(_node_map.count(0), "Missing data, pt_id = 0");
+  _lefts = _node_map[0]->get_grid_lefts();
+  _bottoms = _node_map[0]->get_grid_bottoms();
 }
 
-void PatternTree::slice(const GridType& grid,
+/**
+ * @brief PickHelper arrays are indexed by vcg_id, so they need max vcg_id + 1
+ * slots
+ */
+uint16_t PatternTree::count_slots(
+    const std::map<uint8_t, VCGNodeType>& map) {
+  uint16_t slots = 0;
+  for (auto& pair : map) {
+    slots = std::max<uint16_t>(slots, pair.first + 1);
+  }
+
+  return slots;
+}
+
+void PatternTree::slice(const GridView& grid,
                         std::map<uint8_t, VCGNodeType>& map) {
-  std::queue<std::pair<int, GridType>> queue;
+  std::queue<std::pair<int, GridView>> queue;
   queue.push({0, grid});
   bool vertical;
 
@@ -318,7 +372,7 @@ void PatternTree::slice(const GridType& grid,
     auto pair = queue.front();
     queue.pop();
 
-    std::queue<GridType> smaller;
+    std::queue<GridView> smaller;
     slice_module(pair.second, vertical, smaller);
     if (smaller.size() == 1) {
       insert_leaves(pair.first, pair.second, map);
@@ -346,9 +400,9 @@ void PatternTree::slice(const GridType& grid,
   }
 }
 
-void PatternTree::slice_module(const GridType& grid /*in*/,
+void PatternTree::slice_module(const GridView& grid /*in*/,
                                bool& vertical /*in*/,
-                               std::queue<GridType>& ret /*out*/) {
+                               std::queue<GridView>& ret /*out*/) {
   clear_queue(ret);
 
   slice_vertical(grid, ret);
@@ -360,24 +414,22 @@ void PatternTree::slice_module(const GridType& grid /*in*/,
   }
 }
 
-void PatternTree::slice_vertical(const GridType& grid /*in*/,
-                                 std::queue<GridType>& ret /*out*/) {
-  ASSERT(grid.size() && grid[0].size(), "Grid data polluted");
-  size_t max_row = grid[0].size();
+void PatternTree::slice_vertical(const GridView& grid /*in*/,
+                                 std::queue<GridView>& ret /*out*/) {
+  ASSERT(grid.get_cols() && grid.get_rows(), "Grid data polluted");
+  size_t max_col = grid.get_cols();
+  size_t max_row = grid.get_rows();
 
   clear_queue(ret);
 
-  if (grid.size() > 1) {
-    // grid.size() > 1
+  if (max_col > 1) {
+    // max_col > 1
 
     size_t col;
-    for (col = 0; col < grid.size() - 1; ++col) {
+    for (col = 0; col < max_col - 1; ++col) {
       size_t row;
       for (row = 0; row < max_row; ++row) {
-        ASSERT(grid[col].size() >= row + 1 || grid[col + 1].size() >= row + 1,
-               "Fill grid first");
-
-        if (grid[col][row] == grid[col + 1][row]) {
+        if (grid.at(col, row) == grid.at(col + 1, row)) {
           break;
         }
       }
@@ -387,30 +439,22 @@ void PatternTree::slice_vertical(const GridType& grid /*in*/,
       }
     }
 
-    GridType left;
-    for (size_t col_left = 0; col_left <= col; ++col_left) {
-      left.push_back(grid[col_left]);
-    }
-    ret.push(left);
-
-    if (col + 1 < grid.size()) {
-      GridType right;
-      for (col = col + 1; col < grid.size(); ++col) {
-        right.push_back(grid[col]);
-      }
-      ret.push(right);
+    ret.push(grid.sub_cols(0, col + 1));
+    if (col + 1 < max_col) {
+      ret.push(grid.sub_cols(col + 1, max_col));
     }
 
   } else {
-    // grid.size() == 1
+    // max_col == 1
     ret.push(grid);
   }
 }
 
-void PatternTree::slice_horizontal(const GridType& grid /*in*/,
-                                   std::queue<GridType>& ret /*out*/) {
-  ASSERT(grid.size() && grid[0].size(), "Grid data polluted");
-  size_t max_row = grid[0].size();
+void PatternTree::slice_horizontal(const GridView& grid /*in*/,
+                                   std::queue<GridView>& ret /*out*/) {
+  ASSERT(grid.get_cols() && grid.get_rows(), "Grid data polluted");
+  size_t max_col = grid.get_cols();
+  size_t max_row = grid.get_rows();
 
   clear_queue(ret);
 
@@ -420,42 +464,22 @@ void PatternTree::slice_horizontal(const GridType& grid /*in*/,
     size_t row;
     for (row = 0; row < max_row - 1; ++row) {
       size_t col;
-      for (col = 0; col < grid.size(); ++col) {
-        ASSERT(grid[col].size() >= row + 1 || grid[col + 1].size() >= row + 1,
-               "Fill grid first");
-
-        if (grid[col][row] == grid[col][row + 1]) {
+      for (col = 0; col < max_col; ++col) {
+        if (grid.at(col, row) == grid.at(col, row + 1)) {
           break;
         }
       }
 
-      if (col == grid.size()) {
+      if (col == max_col) {
         break;
       }
     }
 
-    GridType down;
-    for (auto column : grid) {
-      if (column.begin() + row + 1 < column.begin() + max_row) {
-        std::vector<uint8_t> col_vec(column.begin() + row + 1,
-                                     column.begin() + max_row);
-        down.push_back(col_vec);
-      }
-    }
-    if (down.size()) {
-      ret.push(down);
-    }
-
-    GridType top;
-    for (auto column : grid) {
-      if (column.begin() < column.begin() + row + 1) {
-        std::vector<uint8_t> col_vec(column.begin(), column.begin() + row + 1);
-        top.push_back(col_vec);
-      }
-    }
-    if (top.size()) {
-      ret.push(top);
+    // down first, then top
+    if (row + 1 < max_row) {
+      ret.push(grid.sub_rows(row + 1, max_row));
     }
+    ret.push(grid.sub_rows(0, row + 1));
 
   } else {
     // max_row == 1
@@ -463,7 +487,7 @@ void PatternTree::slice_horizontal(const GridType& grid /*in*/,
   }
 }
 
-void PatternTree::insert_leaves(int parent_pt_id, const GridType& grid,
+void PatternTree::insert_leaves(int parent_pt_id, const GridView& grid,
                                 std::map<uint8_t, VCGNodeType>& map) {
   std::vector<uint8_t> order;
   get_topological_sort(grid, order);
@@ -506,7 +530,8 @@ void PatternTree::insert_leaves(int parent_pt_id, const GridType& grid,
     for (auto id : order) {
       ASSERT(map.count(id),
              "Can't find map between gird_id(%hhu) and VCGNodeType", id);
-      auto pt_node = new PTNode(_node_map.size(), get_pt_type(map[id]), {{id}});
+      auto pt_node =
+          new PTNode(_node_map.size(), get_pt_type(map[id]), grid.find(id));
       ASSERT(_node_map.count(pt_node->get_pt_id()) == 0,
              "Have existed pt_id = %d", pt_wheel->get_pt_id());
       _node_map[pt_node->get_pt_id()] = pt_node;
@@ -537,7 +562,7 @@ std::map<uint8_t, VCGNodeType> VCG::make_id_type_map() {
   return map;
 }
 
-void PatternTree::get_topological_sort(const GridType& grid /*in*/,
+void PatternTree::get_topological_sort(const GridView& grid /*in*/,
                                        std::vector<uint8_t>& order /*out*/) {
   order.clear();
 
@@ -561,7 +586,7 @@ void PatternTree::get_topological_sort(const GridType& grid /*in*/,
 }
 
 void PatternTree::get_zero_in_nodes(
-    const GridType& grid /*in*/,
+    const GridView& grid /*in*/,
     const std::map<uint8_t, std::set<uint8_t>>& in_edges /*in*/,
     std::queue<uint8_t>& zero_in /*out*/) {
   // store before
@@ -584,13 +609,14 @@ void PatternTree::get_zero_in_nodes(
                       std::vector<std::pair<size_t, uint8_t>>,
                       std::greater<std::pair<size_t, uint8_t>>>
       min_col_2_id;
-  for (size_t col = 0; col < grid.size(); ++col) {
-    for (size_t row = 0; row < grid[col].size(); ++row) {
-      if (zero_in_set.count(grid[col][row])       // zero in-edge
-          && in_queue.count(grid[col][row]) == 0  // not in queue
+  for (size_t col = 0; col < grid.get_cols(); ++col) {
+    for (size_t row = 0; row < grid.get_rows(); ++row) {
+      auto id = grid.at(col, row);
+      if (zero_in_set.count(id)       // zero in-edge
+          && in_queue.count(id) == 0  // not in queue
       ) {
-        min_col_2_id.push({col, grid[col][row]});
-        in_queue.insert(grid[col][row]);
+        min_col_2_id.push({col, id});
+        in_queue.insert(id);
       }
     }
   }
@@ -609,6 +635,12 @@ PatternTree::~PatternTree() {
 
   _pt_grid_map.clear();
 
+  // after picks of nodes are returned into pools
+  for (auto worker : _workers) {
+    delete worker;
+  }
+  _workers.clear();
+
   _cm = nullptr;   // not release here
   _cst = nullptr;  // not release here
   _vcg = nullptr;  // not release here
@@ -617,7 +649,6 @@ PatternTree::~PatternTree() {
 PTNode::~PTNode() {
   _parent = nullptr;
   _children.clear();
-  _grid.clear();
 
   for (auto p : _picks) {
     delete p;
@@ -628,6 +659,18 @@ PTNode::~PTNode() {
 void VCG::traverse_tree() { _tree->postorder_traverse(); }
 
 void PatternTree::postorder_traverse() {
+#ifdef ALLOC_STAT
+  auto heap_num = g_alloc_num;
+#endif
+  // picks created in traversal live in pools of workers
+  for (size_t i = _workers.size(); i < _config._threads; ++i) {
+    _workers.push_back(new MergeWorker(
+        sizeof(PickHelper), PickHelper::get_data_size(_slots, _classes)));
+  }
+  PickHelper::_pool = &_workers[0]->_helper_pool;
+  PickHelper::_data_pool = &_workers[0]->_data_pool;
+  auto start = std::chrono::steady_clock::now();
+
   std::vector<int> preorder;
   std::vector<int> postorder;
 
@@ -649,6 +692,78 @@ void PatternTree::postorder_traverse() {
     // debug
     // printf("%2d, ", *it);
   }
+
+  PickHelper::_pool = nullptr;
+  PickHelper::_data_pool = nullptr;
+
+  std::chrono::duration<double, std::milli> ms =
+      std::chrono::steady_clock::now() - start;
+  debug_traverse_stat(ms.count());
+#ifdef ALLOC_STAT
+  debug_alloc_stat(g_alloc_num - heap_num);
+#else
+  debug_alloc_stat(0);
+#endif
+}
+
+/**
+ * @brief log allocations of traversal. Every pick used to be a malloc, now
+ * mallocs only happen when pools grow.
+ *
+ * @param heap_num  heap allocations in traversal, only with ALLOC_STAT
+ */
+void PatternTree::debug_alloc_stat(size_t heap_num) {
+#if !defined(G_LOG) || !defined(SEARCH_STAT)
+  return;
+#endif
+  size_t pair_num = 0;
+  size_t pick_num = 0;
+  size_t chunk_num = 0;
+  for (auto worker : _workers) {
+    pair_num += worker->_pair_num;
+    pick_num += worker->_helper_pool.get_alloc_num() +
+                worker->_data_pool.get_alloc_num();
+    chunk_num += worker->_helper_pool.get_chunk_num() +
+                 worker->_data_pool.get_chunk_num();
+  }
+  auto per_pair = [pair_num](size_t num) {
+    return pair_num ? 1.0 * num / pair_num : 0.0;
+  };
+
+  g_log << "[alloc] pairs = " << pair_num << ", picks = " << pick_num << " ("
+        << per_pair(pick_num) << "/pair), pool mallocs = " << chunk_num
+        << " (" << per_pair(chunk_num) << "/pair)";
+#ifdef ALLOC_STAT
+  g_log << ", heap = " << heap_num << " (" << per_pair(heap_num) << "/pair)";
+#endif
+  g_log << "\n";
+  g_log.flush();
+}
+
+/**
+ * @brief log time of traversal and cell-conflict checks between picks
+ */
+void PatternTree::debug_traverse_stat(double ms) {
+#if !defined(G_LOG) || !defined(SEARCH_STAT)
+  return;
+#endif
+  size_t repeat_num = 0;
+  size_t stop_num = 0;
+  size_t bound_num = 0;
+  for (auto worker : _workers) {
+    repeat_num += worker->_repeat_num;
+    stop_num += worker->_stop_num;
+    bound_num += worker->_bound_num;
+  }
+  g_log << "[traverse] time = " << ms << " ms, threads = " << _workers.size()
+        << (_config._lazy ? " (lazy)" : "")
+        << ", beam width = " << _config._beam_width
+        << (_config._adaptive ? " (adaptive)" : "")
+        << ", repeat checks = " << repeat_num
+        << ", early stops = " << stop_num
+        << ", bound skips = " << bound_num
+        << ", same placements = " << _same_num << "\n";
+  g_log.flush();
 }
 
 void PatternTree::visit_pt_node(int pt_id) {
@@ -667,12 +782,13 @@ void PatternTree::visit_pt_node(int pt_id) {
       merge_vtc(pt_node);
       break;
     case kPTWheel:
-      merge_wheel(pt_node);
+      merge_children(pt_node);
       break;
 
     default:
       PANIC("Unhandled pt_node type = %d", pt_node->get_type());
   }
+  prune_dominated(pt_node);
 
   if (pt_node->get_picks().size() == 0) {
     g_log << "No picks generate in pt_id = " << pt_node->get_pt_id() << "\n";
@@ -691,7 +807,8 @@ void PatternTree::list_possibility(PTNode* pt_node) {
 
   CellType c_type = kCellTypeNull;
   get_celltype(pt_node->get_type(), c_type);
-  auto cells = _cm->choose_cells(c_type);
+  // cells of one class are interchangeable, list the first one only
+  auto& cells = _cm->choose_class_cells(c_type);
 
   ASSERT(_pt_grid_map.count(pt_node->get_pt_id()), "no map of pt_id = %d",
          pt_node->get_pt_id());
@@ -699,112 +816,218 @@ void PatternTree::list_possibility(PTNode* pt_node) {
 
   PickHelper* p = nullptr;
   for (auto cell : cells) {
-    p = new PickHelper(grid_value, cell->get_cell_id(), cell->get_rotation());
+    p = new PickHelper(_slots, _classes, grid_value, cell);
     p->set_box(0, 0, cell->get_width(), cell->get_height());
     pt_node->insert_pick(p);
 
     if (cell->is_square()) continue;
     cell->rotate();
 
-    p = new PickHelper(grid_value, cell->get_cell_id(), cell->get_rotation());
+    p = new PickHelper(_slots, _classes, grid_value, cell);
     p->set_box(0, 0, cell->get_width(), cell->get_height());
     pt_node->insert_pick(p);
   }
 }
 
+/**
+ * @brief Remove picks dominated by another pick of pt_node, which picks the
+ * same cells within a box no wider and no higher. Of picks with the same
+ * box, the one with least (death, order) is kept. Survivors keep their
+ * relative order.
+ */
+void PatternTree::prune_dominated(PTNode* pt_node) {
+  auto& picks = pt_node->get_picks();
+  if (picks.size() < 2) return;
+
+  // group by cells, then ascending width, height and (death, order)
+  std::vector<size_t> sorted(picks.size());
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    sorted[i] = i;
+  }
+  std::sort(sorted.begin(), sorted.end(), [&picks](size_t i1, size_t i2) {
+    auto p1 = picks[i1];
+    auto p2 = picks[i2];
+    auto cmp = p1->compare_cells(p2);
+    if (cmp) return cmp < 0;
+    auto w1 = p1->get_box().get_width();
+    auto w2 = p2->get_box().get_width();
+    if (w1 != w2) return w1 < w2;
+    auto h1 = p1->get_box().get_height();
+    auto h2 = p2->get_box().get_height();
+    if (h1 != h2) return h1 < h2;
+    return CmpPickHelperDeath()(p1, p2);
+  });
+
+  // a pick survives if it is lower than all narrower picks of its group
+  std::vector<bool> dominated(picks.size(), false);
+  size_t dominated_num = 0;
+  int min_height = 0;
+  for (size_t i = 0; i < sorted.size(); ++i) {
+    auto pick = picks[sorted[i]];
+    auto height = pick->get_box().get_height();
+    if (i == 0 || pick->compare_cells(picks[sorted[i - 1]])) {
+      min_height = height;
+    } else if (height >= min_height) {
+      dominated[sorted[i]] = true;
+      ++dominated_num;
+    } else {
+      min_height = height;
+    }
+  }
+  if (dominated_num == 0) return;
+
+#ifdef SEARCH_STAT
+  g_log << "[prune] pt_id = " << pt_node->get_pt_id()
+        << ", picks = " << picks.size() << ", dominated = " << dominated_num
+        << "\n";
+#endif
+
+  std::vector<PickHelper*> kept;
+  kept.reserve(picks.size() - dominated_num);
+  for (size_t i = 0; i < picks.size(); ++i) {
+    if (dominated[i]) {
+      delete picks[i];
+    } else {
+      kept.push_back(picks[i]);
+    }
+  }
+  pt_node->set_picks(std::move(kept));
+}
+
 void PatternTree::merge_hrz(PTNode* pt_node) {
   assert(pt_node && pt_node->get_type() == kPTVertical);
-  auto children = pt_node->get_children();
+  auto& children = pt_node->get_children();
   ASSERT(children.size() == 2, "Topology error");
   auto lchild = children[0];
   auto rchild = children[1];
+  auto& lpicks = lchild->get_picks();
+  auto& rpicks = rchild->get_picks();
+  auto width = get_beam_width(pt_node);
 
-  std::set<uint8_t> lpick_vcg_id_set;
-  std::set<uint8_t> rpick_vcg_id_set;
-  std::vector<PickItem*> l_items;
-  std::vector<PickItem*> r_items;
-  DeathQue death_queue;
-  Rectangle box;
-  for (auto lpick : lchild->get_picks()) {
-    PickHelper* lpick_new = new PickHelper(lpick);
+  std::vector<int> r_areas(rpicks.size());
+  for (size_t r_index = 0; r_index < rpicks.size(); ++r_index) {
+    r_areas[r_index] = get_cells_area(rpicks[r_index]);
+  }
+
+  // copy of left pick against interposer, with its items next to right child
+  auto adjust_lpick = [&](size_t l_index, std::vector<uint8_t>& l_items) {
+    Rectangle box;
+    PickHelper* lpick_new = new PickHelper(lpicks[l_index]);
 
     // interposer
-    lchild->get_grid_lefts(lpick_vcg_id_set);
-    lpick_new->get_items(lpick_vcg_id_set, l_items);
-    adjust_interposer_left(l_items);
+    lpick_new->get_items(lchild->get_grid_lefts(), l_items);
+    adjust_interposer_left(lpick_new, l_items);
 
-    lchild->get_grid_bottoms(lpick_vcg_id_set);
-    lpick_new->get_items(lpick_vcg_id_set, l_items);
-    adjust_interposer_bottom(l_items);
+    lpick_new->get_items(lchild->get_grid_bottoms(), l_items);
+    adjust_interposer_bottom(lpick_new, l_items);
 
     // update left box
     get_helper_box(lpick_new, box);
     lpick_new->set_box(box);
 
-    lchild->get_grid_rights(lpick_vcg_id_set);
-    lpick_new->get_items(lpick_vcg_id_set, l_items);
+    lpick_new->get_items(lchild->get_grid_rights(), l_items);
+    return lpick_new;
+  };
 
-    for (auto rpick : rchild->get_picks()) {
-      if (is_pick_repeat(lpick_new, rpick)) continue;
+  // merge an adjusted left pick with one right pick
+  auto merge_pair = [&](PickHelper* lpick_new,
+                        const std::vector<uint8_t>& l_items, size_t l_index,
+                        size_t r_index, MergeWorker& worker,
+                        DeathQue& death_queue) {
+    std::vector<uint8_t> r_items;
+    Rectangle box;
 
-      PickHelper* rpick_new = new PickHelper(rpick);
+    auto rpick = rpicks[r_index];
+    ++worker._repeat_num;
+    if (is_pick_repeat(lpick_new, rpick)) return;
 
-      // interposer
-      rchild->get_grid_bottoms(rpick_vcg_id_set);
-      rpick_new->get_items(rpick_vcg_id_set, r_items);
-      adjust_interposer_bottom(r_items);
+    PickHelper* rpick_new = new PickHelper(rpick);
 
-      // update right box
-      get_helper_box(rpick_new, box);
-      rpick_new->set_box(box);
+    // interposer
+    rpick_new->get_items(rchild->get_grid_bottoms(), r_items);
+    adjust_interposer_bottom(rpick_new, r_items);
 
-      // two pt_node
-      rchild->get_grid_lefts(rpick_vcg_id_set);
-      rpick_new->get_items(rpick_vcg_id_set, r_items);
+    // update right box
+    get_helper_box(rpick_new, box);
+    rpick_new->set_box(box);
 
-      Point range;
-      get_box_range_fit_litems(r_items, l_items, lpick_new->get_box()._c3._x,
-                               range);
-      int x_move = range._x;
-      if (range._x > range._y) {
-        x_move = range._x;
-
-        // g_log << "[HRZ merging violate] occur in pt_node = "
-        //       << std::to_string(pt_node->get_pt_id())  << ", "
-        //       << "range.min_x = " << range._x << ", "
-        //       << "range.max_x = " << range._y << "\n";
-      }
+    // two pt_node
+    rpick_new->get_items(rchild->get_grid_lefts(), r_items);
 
-      for (auto r_item : rpick_new->get_items()) {
-        r_item->_c1_x += x_move;
-      }
+    Point range;
+    get_box_range_fit_litems(rpick_new, r_items, lpick_new, l_items,
+                             lpick_new->get_box()._c3._x, range);
+    int x_move = range._x;
+    if (range._x > range._y) {
+      x_move = range._x;
+
+      // g_log << "[HRZ merging violate] occur in pt_node = "
+      //       << std::to_string(pt_node->get_pt_id())  << ", "
+      //       << "range.min_x = " << range._x << ", "
+      //       << "range.max_x = " << range._y << "\n";
+    }
 
-      PickHelper* new_helper = new PickHelper(lpick_new, rpick_new);
+    rpick_new->move_x(x_move);
 
-      get_helper_box(new_helper, box);
-      new_helper->set_box(box);
-      int cell_area = get_cells_area(new_helper);
-      new_helper->set_death(1.0 * (box.get_area() - cell_area) /
-                            box.get_area());
+    PickHelper* new_helper = new PickHelper(lpick_new, rpick_new);
+    new_helper->set_order(l_index * rpicks.size() + r_index);
+    ++worker._pair_num;
 
-      // debug
-      // debug_GDS(new_helper);
+    get_helper_box(new_helper, box);
+    new_helper->set_box(box);
+    int cell_area = get_cells_area(new_helper);
+    new_helper->set_death(1.0 * (box.get_area() - cell_area) /
+                          box.get_area());
 
-      if (!insert_death_que(death_queue, new_helper)) {
-        delete new_helper;
-      }
+    // debug
+    // debug_GDS(new_helper);
 
-      delete rpick_new;
+    worker._best_death = std::min(worker._best_death, new_helper->get_death());
+    if (!insert_death_que(death_queue, new_helper, width)) {
+      delete new_helper;
+    }
 
-    }  // end for auto rpick
+    delete rpick_new;
+  };
+
+  // merge one left pick with all right picks
+  auto merge_lpick = [&](size_t l_index, MergeWorker& worker,
+                         DeathQue& death_queue) {
+    std::vector<uint8_t> l_items;
+    auto lpick_new = adjust_lpick(l_index, l_items);
+    auto l_box = lpick_new->get_box();
+    auto l_area = get_cells_area(lpick_new);
+
+    for (size_t r_index = 0; r_index < rpicks.size(); ++r_index) {
+      // right box lies right of left box, its width never changes
+      auto r_box = rpicks[r_index]->get_box();
+      if (is_bound_out(death_queue, width,
+                       l_box.get_width() + r_box.get_width(),
+                       std::max(l_box.get_height(), r_box.get_height()),
+                       l_area + r_areas[r_index])) {
+        ++worker._bound_num;
+        continue;
+      }
+
+      merge_pair(lpick_new, l_items, l_index, r_index, worker, death_queue);
+    }
 
     delete lpick_new;
-  }  // end for auto lpick
+  };
+
+  DeathQue death_queue;
+  if (_config._lazy) {
+    lazy_merge(lpicks.size(), adjust_lpick, rpicks, r_areas, true, merge_pair,
+               width, death_queue);
+  } else {
+    parallel_merge(lpicks.size(), merge_lpick, width, death_queue);
+  }
 
   if (death_queue.size() == 0) {
     second_pick_replace(lchild, rchild, death_queue);
   }
 
+  _same_num += death_queue.get_same_num();
   while (death_queue.size()) {
     auto pick = death_queue.top();
     death_queue.pop();
@@ -816,70 +1039,250 @@ void PatternTree::merge_hrz(PTNode* pt_node) {
 }
 
 /**
- * @brief Construct a new Pick Helper:: Pick Helper object
+ * @brief Merge picks of children on worker threads. Each worker merges
+ * whole rows of pairs into its own death queue, then all queues are reduced
+ * into queue. As picks are ordered by (death, order), the result does not
+ * depend on the number of threads, unless a time budget stops merging.
  *
- * @param first   cells chosen first
- * @param second  cells chosen later
+ * @param num         rows of pairs, usually picks of first child
+ * @param merge_row   merge one row into a worker's queue
+ * @param width       picks kept
+ * @param queue       merged picks
  */
-PickHelper::PickHelper(PickHelper* first, PickHelper* second) : _death(0) {
-  ASSERT(first && second, "Please enter valid data");
+void PatternTree::parallel_merge(
+    size_t num /*in*/,
+    const std::function<void(size_t, MergeWorker&, DeathQue&)>& merge_row,
+    size_t width /*in*/, DeathQue& queue /*out*/) {
+  auto threads = std::min(_workers.size(), num);
+  std::vector<DeathQue> queues(std::max<size_t>(threads, 1));
+  std::atomic<size_t> next(0);
+  auto work = [&](size_t w) {
+    auto worker = _workers[w];
+    auto& local = threads > 1 ? queues[w] : queue;
+    auto helper_pool = PickHelper::_pool;
+    auto data_pool = PickHelper::_data_pool;
+    PickHelper::_pool = &worker->_helper_pool;
+    PickHelper::_data_pool = &worker->_data_pool;
+
+    // budget counts from the last improvement of best death
+    worker->_best_death = std::numeric_limits<float>::max();
+    auto best_death = worker->_best_death;
+    auto best_pair = worker->_pair_num;
+    auto best_time = std::chrono::steady_clock::now();
+    for (size_t i = next++; i < num; i = next++) {
+      merge_row(i, *worker, local);
+
+      if (worker->_best_death < best_death) {
+        best_death = worker->_best_death;
+        best_pair = worker->_pair_num;
+        best_time = std::chrono::steady_clock::now();
+      } else if (local.size() >= width &&
+                 is_over_budget(worker->_pair_num - best_pair, best_time)) {
+        ++worker->_stop_num;
+        break;
+      }
+    }
+
+    PickHelper::_pool = helper_pool;
+    PickHelper::_data_pool = data_pool;
+  };
+
+  if (threads <= 1) {
+    work(0);
+    return;
+  }
 
-  for (auto item : first->get_items()) {
-    _items.push_back(new PickItem(*item));
+  std::vector<std::thread> pool;
+  for (size_t w = 1; w < threads; ++w) {
+    pool.emplace_back(work, w);
   }
-  for (auto item : second->get_items()) {
-    _items.push_back(new PickItem(*item));
+  work(0);
+  for (auto& t : pool) {
+    t.join();
   }
-  for (auto item : _items) {
-    _id_item_map[item->_vcg_id] = item;
+
+  // reduce
+  for (auto& q : queues) {
+    queue.add_same_num(q.get_same_num());
+    while (q.size()) {
+      auto pick = q.top();
+      q.pop();
+      if (!insert_death_que(queue, pick, width)) {
+        delete pick;
+      }
+    }
   }
 }
 
-bool PatternTree::is_pick_repeat(PickHelper* pick1, PickHelper* pick2) {
-  if (!pick1 || !pick2) return false;
+/**
+ * @brief Merge picks of two children best-first instead of row by row.
+ * Pairs are built in order of the lower bound of their death, see
+ * is_bound_out(), and merging stops once queue is full and no pair left can
+ * beat its worst pick. So the result is the same as merging all pairs, while
+ * most hopeless pairs are never built. It runs on the first worker only.
+ *
+ * @param f_num       picks of first child
+ * @param adjust      copy of a first pick against interposer, with its items
+ *                    next to second child
+ * @param s_picks     picks of second child
+ * @param s_areas     cell areas of s_picks
+ * @param horizontal  second child is right of first child, or above it
+ * @param merge_pair  merge an adjusted first pick with a second pick
+ * @param width       picks kept
+ * @param queue       merged picks
+ */
+void PatternTree::lazy_merge(
+    size_t f_num /*in*/,
+    const std::function<PickHelper*(size_t, std::vector<uint8_t>&)>& adjust,
+    const std::vector<PickHelper*>& s_picks /*in*/,
+    const std::vector<int>& s_areas /*in*/, bool horizontal /*in*/,
+    const std::function<void(PickHelper*, const std::vector<uint8_t>&, size_t,
+                             size_t, MergeWorker&, DeathQue&)>& merge_pair,
+    size_t width /*in*/, DeathQue& queue /*out*/) {
+  auto& worker = *_workers[0];
+  std::vector<PickHelper*> f_picks(f_num);
+  std::vector<std::vector<uint8_t>> f_items(f_num);
+  for (size_t f_index = 0; f_index < f_num; ++f_index) {
+    f_picks[f_index] = adjust(f_index, f_items[f_index]);
+  }
+
+  // (bound, order) packed to sort as integers, as bounds are not negative
+  // their bits keep the order of floats; order breaks ties as in queue
+  ASSERT(f_num * s_picks.size() <= UINT32_MAX, "Too many pairs to order");
+  std::vector<uint64_t> keys;
+  keys.reserve(f_num * s_picks.size());
+  for (size_t f_index = 0; f_index < f_num; ++f_index) {
+    auto f_box = f_picks[f_index]->get_box();
+    auto f_area = get_cells_area(f_picks[f_index]);
+    for (size_t s_index = 0; s_index < s_picks.size(); ++s_index) {
+      auto s_box = s_picks[s_index]->get_box();
+      int w = horizontal ? f_box.get_width() + s_box.get_width()
+                         : std::max(f_box.get_width(), s_box.get_width());
+      int h = horizontal ? std::max(f_box.get_height(), s_box.get_height())
+                         : f_box.get_height() + s_box.get_height();
+      float bound = get_death_bound(w, h, f_area + s_areas[s_index]);
+      uint32_t bits;
+      memcpy(&bits, &bound, sizeof(bits));
+      keys.push_back((uint64_t)bits << 32 |
+                     (f_index * s_picks.size() + s_index));
+    }
+  }
+
+  worker._best_death = std::numeric_limits<float>::max();
+  auto best_death = worker._best_death;
+  auto best_pair = worker._pair_num;
+  auto best_time = std::chrono::steady_clock::now();
+
+  // sort keys in growing chunks, most pairs are never sorted
+  size_t begin = 0;
+  size_t chunk = width;
+  bool stop = false;
+  while (!stop && begin < keys.size()) {
+    auto end = std::min(keys.size(), begin + chunk);
+    std::nth_element(keys.begin() + begin, keys.begin() + end - 1, keys.end());
+    std::sort(keys.begin() + begin, keys.begin() + end);
+
+    for (; begin < end && !stop; ++begin) {
+      uint32_t bits = keys[begin] >> 32;
+      float bound;
+      memcpy(&bound, &bits, sizeof(bound));
+      if (queue.size() >= width && bound > queue.top()->get_death()) {
+        stop = true;
+        break;
+      }
 
-  for (auto item1 : pick1->get_items()) {
-    for (auto item2 : pick2->get_items()) {
-      if (item1->_cell_id == item2->_cell_id) {
-        return true;
+      size_t order = keys[begin] & UINT32_MAX;
+      auto f_index = order / s_picks.size();
+      merge_pair(f_picks[f_index], f_items[f_index], f_index,
+                 order % s_picks.size(), worker, queue);
+
+      if (worker._best_death < best_death) {
+        best_death = worker._best_death;
+        best_pair = worker._pair_num;
+        best_time = std::chrono::steady_clock::now();
+      } else if (queue.size() >= width &&
+                 is_over_budget(worker._pair_num - best_pair, best_time)) {
+        ++worker._stop_num;
+        stop = true;
       }
     }
+    chunk *= 2;
   }
+  worker._bound_num += keys.size() - begin;
 
+  for (auto pick : f_picks) {
+    delete pick;
+  }
+}
+
+bool PatternTree::is_over_budget(
+    size_t pairs, std::chrono::steady_clock::time_point since) {
+  if (_config._pair_budget && pairs >= _config._pair_budget) {
+    return true;
+  }
+  if (_config._time_budget) {
+    std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - since;
+    return ms.count() >= _config._time_budget;
+  }
   return false;
 }
 
-void PatternTree::adjust_interposer_left(std::vector<PickItem*>& left_items) {
-  for (auto item : left_items) {
-    if (!is_interposer_left(item->_vcg_id)) continue;
+/**
+ * @brief picks kept in pt_node. In adaptive mode the width is scaled by the
+ * share of cells under pt_node, from half of beam width to twice of it at
+ * root.
+ */
+size_t PatternTree::get_beam_width(PTNode* pt_node) {
+  auto width = _config._beam_width;
+  if (!_config._adaptive) return width;
 
-    auto cell = _cm->get_cell(item->_cell_id);
-    ASSERT(cell, "Missing cell whose c_id = %d", item->_cell_id);
+  auto scaled = 2 * width * pt_node->get_cells_num() / _pt_grid_map.size();
+  return std::min(2 * width, std::max(std::max<size_t>(width / 2, 1), scaled));
+}
 
-    set_cell_status(cell, item);
+/**
+ * @brief Construct a new Pick Helper:: Pick Helper object
+ *
+ * @param first   cells chosen first
+ * @param second  cells chosen later
+ */
+PickHelper::PickHelper(PickHelper* first, PickHelper* second)
+    : _items_num(0), _death(0), _order(0), _hash(0) {
+  ASSERT(first && second, "Please enter valid data");
 
-    auto celltype = cell->get_cell_type();
-    Point range;
-    get_cst_x(celltype, range);
-    item->_c1_x = range._x;
-  }
+  _items_num = first->_items_num;
+  _id_set = first->_id_set;
+  copy_data(first);
+  insert_items(second);
 }
 
-void PatternTree::adjust_interposer_bottom(
-    std::vector<PickItem*>& bottom_items) {
-  for (auto item : bottom_items) {
-    if (!is_interposer_bottom(item->_vcg_id)) continue;
+bool PatternTree::is_pick_repeat(PickHelper* pick1, PickHelper* pick2) {
+  if (!pick1 || !pick2) return false;
 
-    auto cell = _cm->get_cell(item->_cell_id);
-    ASSERT(cell, "Missing cell whose c_id = %d", item->_cell_id);
+  return pick1->is_cells_exceed(pick2, _class_amount.data());
+}
 
-    set_cell_status(cell, item);
+void PatternTree::adjust_interposer_left(
+    PickHelper* helper /*out*/, const std::vector<uint8_t>& left_items /*in*/) {
+  Point range;
+  for (auto id : left_items) {
+    if (!is_interposer_left(id)) continue;
 
-    auto celltype = cell->get_cell_type();
-    Point range;
-    get_cst_y(celltype, range);
-    cell->set_y(range._x);
-    item->_c1_y = range._x;
+    get_cst_x(get_item_type(helper, id), range);
+    helper->set_x(id, range._x);
+  }
+}
+
+void PatternTree::adjust_interposer_bottom(
+    PickHelper* helper /*out*/,
+    const std::vector<uint8_t>& bottom_items /*in*/) {
+  Point range;
+  for (auto id : bottom_items) {
+    if (!is_interposer_bottom(id)) continue;
+
+    get_cst_y(get_item_type(helper, id), range);
+    helper->set_y(id, range._x);
   }
 }
 
@@ -1028,74 +1431,168 @@ void VCG::get_interposer_c3(int ret_arr[4] /*out*/) {
   ret_arr[3] = max_y;
 }
 
+/**
+ * @brief reject a pattern before any pick, by cell counts and by
+ * is_axis_infeasible() on both axes
+ */
+bool VCG::is_topology_infeasible() {
+  int mem_nodes = 0;
+  int soc_nodes = 0;
+  for (auto node : _adj_list) {
+    mem_nodes += node->get_type() == kVCG_MEM;
+    soc_nodes += node->get_type() == kVCG_SOC;
+  }
+  if (mem_nodes > (int)_cm->choose_cells(kCellTypeMem).size() ||
+      soc_nodes > (int)_cm->choose_cells(kCellTypeSoc).size()) {
+    return true;
+  }
+
+  return is_axis_infeasible(true) || is_axis_infeasible(false);
+}
+
+/**
+ * @brief Every cell spans c1 to c3 on the axis, with a length between the
+ * shortest and longest edge of its cell type. On y, a cell keeps the spacing
+ * range to each cell below it in its grid columns (VCG froms). Cells on the
+ * sides of _id_grid keep the interposer spacing range. Grid neighbours in a
+ * row are not related, a pick may place them without facing. These
+ * difference constraints hold for every pick, so a positive cycle proves
+ * that no pick fits the pattern.
+ *
+ * @param is_x  x axis uses first and last column, y axis uses froms and tos
+ */
+bool VCG::is_axis_infeasible(bool is_x) {
+  // vertex 0 and sink are left (bottom) and right (top) side of interposer
+  auto c1 = [](uint8_t id) { return 2 * id + 1; };
+  auto c3 = [](uint8_t id) { return 2 * id + 2; };
+  const int sink = 2 * _adj_list.size() + 1;
+  std::vector<std::tuple<int, int, int>> edges;  // to - from >= weight
+
+  auto add_range = [&](int from, int to, const Point& range) {
+    edges.emplace_back(from, to, range._x);
+    edges.emplace_back(to, from, -range._y);
+  };
+
+  Point range;
+  for (size_t id = 0; id < _adj_list.size(); ++id) {
+    auto type = get_cell_type(id);
+    if (type == kCellTypeNull) continue;
+
+    auto& cells = _cm->choose_class_cells(type);
+    if (cells.empty()) return false;  // cell counts above report it
+    int min_len = std::numeric_limits<int>::max();
+    int max_len = 0;
+    for (auto cell : cells) {
+      min_len = std::min(min_len, (int)cell->get_min_edge());
+      max_len = std::max(max_len, (int)cell->get_max_edge());
+    }
+    edges.emplace_back(0, c1(id), 0);
+    edges.emplace_back(c3(id), sink, 0);
+    add_range(c1(id), c3(id), Point(min_len, max_len));
+
+    if (is_x) continue;
+    for (auto from : _adj_list[id]->get_froms()) {
+      if (from->get_type() == kVCG_START) {
+        get_cst_y(id, range);
+        add_range(0, c1(id), range);
+      } else {
+        get_cst_y(id, from->get_vcg_id(), range);
+        add_range(c3(from->get_vcg_id()), c1(id), range);
+      }
+    }
+    for (auto to : _adj_list[id]->get_tos()) {
+      if (to->get_type() != kVCG_END) continue;
+      get_cst_y(id, range);
+      add_range(c3(id), sink, range);
+    }
+  }
+
+  if (is_x && _id_grid.size()) {
+    std::set<uint8_t> left(_id_grid.front().begin(), _id_grid.front().end());
+    std::set<uint8_t> right(_id_grid.back().begin(), _id_grid.back().end());
+    for (auto id : left) {
+      if (get_cell_type(id) == kCellTypeNull) continue;
+      get_cst_x(id, range);
+      add_range(0, c1(id), range);
+    }
+    for (auto id : right) {
+      if (get_cell_type(id) == kCellTypeNull) continue;
+      get_cst_x(id, range);
+      add_range(c3(id), sink, range);
+    }
+  }
+
+  // longest paths from every vertex, still relaxing after sink + 1 rounds
+  // means a positive cycle
+  std::vector<int> dist(sink + 1, 0);
+  for (int round = 0; round <= sink; ++round) {
+    bool relaxed = false;
+    for (auto& edge : edges) {
+      int from, to, weight;
+      std::tie(from, to, weight) = edge;
+      if (dist[from] + weight > dist[to]) {
+        dist[to] = dist[from] + weight;
+        relaxed = true;
+      }
+    }
+    if (!relaxed) return false;
+  }
+  return true;
+}
+
 void PatternTree::get_box_range_fit_litems(
-    const std::vector<PickItem*>& r_items /*in*/,
-    const std::vector<PickItem*>& l_items /*in*/, int l_box_c3_x /*in*/,
-    Point& r_box_left /*out*/) {
+    PickHelper* r_pick /*in*/, const std::vector<uint8_t>& r_items /*in*/,
+    PickHelper* l_pick /*in*/, const std::vector<uint8_t>& l_items /*in*/,
+    int l_box_c3_x /*in*/, Point& r_box_left /*out*/) {
   int min_x = l_box_c3_x;
   int max_x = 0;
 
-  for (auto r_item : r_items) {
-    auto r_cell = _cm->get_cell(r_item->_cell_id);
-    assert(r_cell);
+  for (auto r_id : r_items) {
+    auto r_box = get_item_box(r_pick, r_id);
+    auto r_type = get_item_type(r_pick, r_id);
 
-    // restore right cell's status
-    set_cell_status(r_cell, r_item);
+    for (auto l_id : l_items) {
+      auto l_box = get_item_box(l_pick, l_id);
 
-    for (auto l_item : l_items) {
-      auto l_cell = _cm->get_cell(l_item->_cell_id);
-      assert(l_cell);
+      if (is_overlap(r_box._c1._y, r_box._c3._y, l_box._c1._y, l_box._c3._y,
+                     false)) {
+        get_cst_x(r_type, get_item_type(l_pick, l_id), r_box_left);
 
-      // restore left cell's status
-      set_cell_status(l_cell, l_item);
-
-      if (is_overlap_y(r_cell, l_cell, false)) {
-        get_cst_x(r_cell->get_cell_type(), l_cell->get_cell_type(), r_box_left);
-
-        min_x = std::max(l_cell->get_c3()._x + r_box_left._x, min_x);
-        max_x = max_x == 0
-                    ? l_cell->get_c3()._x + r_box_left._y
-                    : std::min(l_cell->get_c3()._x + r_box_left._y, max_x);
+        min_x = std::max(l_box._c3._x + r_box_left._x, min_x);
+        max_x = max_x == 0 ? l_box._c3._x + r_box_left._y
+                           : std::min(l_box._c3._x + r_box_left._y, max_x);
       }
-    }  // end auto l_item
-  }    // end auto r_item
+    }  // end auto l_id
+  }    // end auto r_id
 
   r_box_left._x = min_x;
   r_box_left._y = max_x;
 }
 
 void PatternTree::get_box_range_fit_bitems(
-    const std::vector<PickItem*>& t_items /*in*/,
-    const std::vector<PickItem*>& b_items /*in*/, int b_box_c3_y /*in*/,
-    Point& t_box_bottom /*out*/) {
+    PickHelper* t_pick /*in*/, const std::vector<uint8_t>& t_items /*in*/,
+    PickHelper* b_pick /*in*/, const std::vector<uint8_t>& b_items /*in*/,
+    int b_box_c3_y /*in*/, Point& t_box_bottom /*out*/) {
   int min_y = b_box_c3_y;
   int max_y = 0;
 
-  for (auto t_item : t_items) {
-    auto t_cell = _cm->get_cell(t_item->_cell_id);
-    assert(t_cell);
-
-    // restore top cell's status
-    set_cell_status(t_cell, t_item);
-
-    for (auto b_item : b_items) {
-      auto b_cell = _cm->get_cell(b_item->_cell_id);
-      assert(b_cell);
+  for (auto t_id : t_items) {
+    auto t_box = get_item_box(t_pick, t_id);
+    auto t_type = get_item_type(t_pick, t_id);
 
-      // restore bottom cell's status
-      set_cell_status(b_cell, b_item);
+    for (auto b_id : b_items) {
+      auto b_box = get_item_box(b_pick, b_id);
 
-      if (is_overlap_x(t_cell, b_cell, false)) {
-        get_cst_y(t_cell->get_cell_type(), b_cell->get_cell_type(),
-                  t_box_bottom);
+      if (is_overlap(t_box._c1._x, t_box._c3._x, b_box._c1._x, b_box._c3._x,
+                     false)) {
+        get_cst_y(t_type, get_item_type(b_pick, b_id), t_box_bottom);
 
-        min_y = std::max(b_cell->get_c3()._y + t_box_bottom._x, min_y);
-        max_y = max_y == 0
-                    ? b_cell->get_c3()._y + t_box_bottom._y
-                    : std::min(b_cell->get_c3()._y + t_box_bottom._y, max_y);
+        min_y = std::max(b_box._c3._y + t_box_bottom._x, min_y);
+        max_y = max_y == 0 ? b_box._c3._y + t_box_bottom._y
+                           : std::min(b_box._c3._y + t_box_bottom._y, max_y);
       }
-    }  // end auto b_item
-  }    // end auto t_item
+    }  // end auto b_id
+  }    // end auto t_id
 
   t_box_bottom._x = min_y;
   t_box_bottom._y = max_y;
@@ -1104,12 +1601,16 @@ void PatternTree::get_box_range_fit_bitems(
 void PatternTree::debug_GDS(PickHelper* helper) {
   if (!helper) return;
 
-  for (auto item : helper->get_items()) {
-    auto cell = _cm->get_cell(item->_cell_id);
-    if (cell == nullptr) continue;
+  // items hold a class, so give every item its own cell of that class
+  std::vector<int> used(_classes, 0);
+  for (auto id : helper->get_vcg_ids()) {
+    if (helper->get_cell_id(id) == 0) continue;
+    auto item = helper->get_item(id);
+    auto c = helper->get_cell_class(id);
+    auto cell = _cm->get_class_cell(c, used[c]++);
 
     set_cell_status(cell, item);
-    _vcg->do_pick_cell(item->_vcg_id, cell);
+    _vcg->do_pick_cell(item._vcg_id, cell);
   }
   _vcg->gen_GDS();
   _vcg->undo_all_picks();
@@ -1125,26 +1626,18 @@ void PatternTree::get_helper_box(PickHelper* helper /*in*/,
 
   // first
   box.reset();
-  auto items = helper->get_items();
-  ASSERT(items.size(), "No PickItem");
-  auto item0 = items[0];
-  box._c1._x = item0->_c1_x;
-  box._c1._y = item0->_c1_y;
+  ASSERT(helper->get_items_num(), "No PickItem");
+  auto id0 = *helper->get_vcg_ids().begin();
+  box._c1._x = helper->get_x(id0);
+  box._c1._y = helper->get_y(id0);
 
   // later
-  for (auto item : items) {
-    auto cell = _cm->get_cell(item->_cell_id);
-    if (cell == nullptr) {
-      g_log << "cell_id = " << item->_cell_id << "missing\n";
-      continue;
-    }
-
-    set_cell_status(cell, item);
-
-    box._c1._x = std::min(cell->get_x(), box._c1._x);
-    box._c1._y = std::min(cell->get_y(), box._c1._x);
-    box._c3._x = std::max(cell->get_c3()._x, box._c3._x);
-    box._c3._y = std::max(cell->get_c3()._y, box._c3._y);
+  for (auto id : helper->get_vcg_ids()) {
+    auto item_box = get_item_box(helper, id);
+    box._c1._x = std::min(item_box._c1._x, box._c1._x);
+    box._c1._y = std::min(item_box._c1._y, box._c1._y);
+    box._c3._x = std::max(item_box._c3._x, box._c3._x);
+    box._c3._y = std::max(item_box._c3._y, box._c3._y);
   }
 }
 
@@ -1152,14 +1645,9 @@ int PatternTree::get_cells_area(PickHelper* helper) {
   if (!helper) return 0;
 
   int area = 0;
-  for (auto item : helper->get_items()) {
-    auto cell = _cm->get_cell(item->_cell_id);
-    if (cell == nullptr) {
-      g_log << "cell_id = " << item->_cell_id << "missing\n";
-      continue;
-    }
-
-    area += cell->get_area();
+  for (auto id : helper->get_vcg_ids()) {
+    auto& shape = _cm->get_shape(helper->get_cell_index(id));
+    area += shape._width * shape._height;
   }
 
   return area;
@@ -1173,101 +1661,141 @@ void VCG::undo_all_picks() {
 
 void PatternTree::merge_vtc(PTNode* pt_node) {
   assert(pt_node && pt_node->get_type() == KPTHorizontal);
-  auto children = pt_node->get_children();
+  auto& children = pt_node->get_children();
   ASSERT(children.size() == 2, "Topology error");
   auto bchild = children[0];
   auto tchild = children[1];
+  auto& bpicks = bchild->get_picks();
+  auto& tpicks = tchild->get_picks();
+  auto width = get_beam_width(pt_node);
 
-  std::set<uint8_t> bpick_vcg_id_set;
-  std::set<uint8_t> tpick_vcg_id_set;
-  std::vector<PickItem*> b_items;
-  std::vector<PickItem*> t_items;
-  std::priority_queue<PickHelper*, std::vector<PickHelper*>, CmpPickHelperDeath>
-      death_queue;
-  Rectangle box;
-  for (auto bpick : bchild->get_picks()) {
-    PickHelper* bpick_new = new PickHelper(bpick);
+  std::vector<int> t_areas(tpicks.size());
+  for (size_t t_index = 0; t_index < tpicks.size(); ++t_index) {
+    t_areas[t_index] = get_cells_area(tpicks[t_index]);
+  }
+
+  // copy of bottom pick against interposer, with its items below top child
+  auto adjust_bpick = [&](size_t b_index, std::vector<uint8_t>& b_items) {
+    Rectangle box;
+    PickHelper* bpick_new = new PickHelper(bpicks[b_index]);
 
     // interposer
-    bchild->get_grid_lefts(bpick_vcg_id_set);
-    bpick_new->get_items(bpick_vcg_id_set, b_items);
-    adjust_interposer_left(b_items);
+    bpick_new->get_items(bchild->get_grid_lefts(), b_items);
+    adjust_interposer_left(bpick_new, b_items);
 
-    bchild->get_grid_bottoms(bpick_vcg_id_set);
-    bpick_new->get_items(bpick_vcg_id_set, b_items);
-    adjust_interposer_bottom(b_items);
+    bpick_new->get_items(bchild->get_grid_bottoms(), b_items);
+    adjust_interposer_bottom(bpick_new, b_items);
 
     // update bottom box
     get_helper_box(bpick_new, box);
     bpick_new->set_box(box);
 
-    bchild->get_grid_tops(bpick_vcg_id_set);
-    bpick_new->get_items(bpick_vcg_id_set, b_items);
+    bpick_new->get_items(bchild->get_grid_tops(), b_items);
 
     // debug
     // debug_GDS(bpick_new);
+    return bpick_new;
+  };
 
-    for (auto tpick : tchild->get_picks()) {
-      if (is_pick_repeat(bpick_new, tpick)) continue;
+  // merge an adjusted bottom pick with one top pick
+  auto merge_pair = [&](PickHelper* bpick_new,
+                        const std::vector<uint8_t>& b_items, size_t b_index,
+                        size_t t_index, MergeWorker& worker,
+                        DeathQue& death_queue) {
+    std::vector<uint8_t> t_items;
+    Rectangle box;
 
-      PickHelper* tpick_new = new PickHelper(tpick);
+    auto tpick = tpicks[t_index];
+    ++worker._repeat_num;
+    if (is_pick_repeat(bpick_new, tpick)) return;
 
-      // interposer
-      tchild->get_grid_lefts(tpick_vcg_id_set);
-      tpick_new->get_items(tpick_vcg_id_set, t_items);
-      adjust_interposer_left(t_items);
+    PickHelper* tpick_new = new PickHelper(tpick);
 
-      // update top box
-      get_helper_box(tpick_new, box);
-      tpick_new->set_box(box);
+    // interposer
+    tpick_new->get_items(tchild->get_grid_lefts(), t_items);
+    adjust_interposer_left(tpick_new, t_items);
 
-      // two pt_node
-      tchild->get_grid_bottoms(tpick_vcg_id_set);
-      tpick_new->get_items(tpick_vcg_id_set, t_items);
+    // update top box
+    get_helper_box(tpick_new, box);
+    tpick_new->set_box(box);
 
-      Point range;
-      get_box_range_fit_bitems(t_items, b_items, bpick_new->get_box()._c3._y,
-                               range);
-      int y_move = range._x;
-      if (range._x > range._y) {
-        y_move = range._x;
-
-        // g_log << "[VTC merging violate] occur in pt_node = "
-        //       << std::to_string(pt_node->get_pt_id()) << ", "
-        //       << "range.min_y = " << range._x << ", "
-        //       << "range.max_y = " << range._y << "\n";
-      }
+    // two pt_node
+    tpick_new->get_items(tchild->get_grid_bottoms(), t_items);
 
-      for (auto t_item : tpick_new->get_items()) {
-        t_item->_c1_y += y_move;
-      }
+    Point range;
+    get_box_range_fit_bitems(tpick_new, t_items, bpick_new, b_items,
+                             bpick_new->get_box()._c3._y, range);
+    int y_move = range._x;
+    if (range._x > range._y) {
+      y_move = range._x;
+
+      // g_log << "[VTC merging violate] occur in pt_node = "
+      //       << std::to_string(pt_node->get_pt_id()) << ", "
+      //       << "range.min_y = " << range._x << ", "
+      //       << "range.max_y = " << range._y << "\n";
+    }
 
-      PickHelper* new_helper = new PickHelper(bpick_new, tpick_new);
+    tpick_new->move_y(y_move);
 
-      get_helper_box(new_helper, box);
-      new_helper->set_box(box);
-      int cell_area = get_cells_area(new_helper);
-      new_helper->set_death(1.0 * (box.get_area() - cell_area) /
-                            box.get_area());
+    PickHelper* new_helper = new PickHelper(bpick_new, tpick_new);
+    new_helper->set_order(b_index * tpicks.size() + t_index);
+    ++worker._pair_num;
 
-      // debug
-      // debug_GDS(new_helper);
+    get_helper_box(new_helper, box);
+    new_helper->set_box(box);
+    int cell_area = get_cells_area(new_helper);
+    new_helper->set_death(1.0 * (box.get_area() - cell_area) /
+                          box.get_area());
 
-      if (!insert_death_que(death_queue, new_helper)) {
-        delete new_helper;
-      }
+    // debug
+    // debug_GDS(new_helper);
 
-      delete tpick_new;
+    worker._best_death = std::min(worker._best_death, new_helper->get_death());
+    if (!insert_death_que(death_queue, new_helper, width)) {
+      delete new_helper;
+    }
 
-    }  // end for auto tpick
+    delete tpick_new;
+  };
+
+  // merge one bottom pick with all top picks
+  auto merge_bpick = [&](size_t b_index, MergeWorker& worker,
+                         DeathQue& death_queue) {
+    std::vector<uint8_t> b_items;
+    auto bpick_new = adjust_bpick(b_index, b_items);
+    auto b_box = bpick_new->get_box();
+    auto b_area = get_cells_area(bpick_new);
+
+    for (size_t t_index = 0; t_index < tpicks.size(); ++t_index) {
+      // top box lies above bottom box, its height never changes
+      auto t_box = tpicks[t_index]->get_box();
+      if (is_bound_out(death_queue, width,
+                       std::max(b_box.get_width(), t_box.get_width()),
+                       b_box.get_height() + t_box.get_height(),
+                       b_area + t_areas[t_index])) {
+        ++worker._bound_num;
+        continue;
+      }
+
+      merge_pair(bpick_new, b_items, b_index, t_index, worker, death_queue);
+    }
 
     delete bpick_new;
-  }  // end for auto bpick
+  };
+
+  DeathQue death_queue;
+  if (_config._lazy) {
+    lazy_merge(bpicks.size(), adjust_bpick, tpicks, t_areas, false, merge_pair,
+               width, death_queue);
+  } else {
+    parallel_merge(bpicks.size(), merge_bpick, width, death_queue);
+  }
 
   if (death_queue.size() == 0) {
     second_pick_replace(bchild, tchild, death_queue);
   }
 
+  _same_num += death_queue.get_same_num();
   while (death_queue.size()) {
     auto pick = death_queue.top();
     death_queue.pop();
@@ -1283,31 +1811,33 @@ void PatternTree::merge_vtc(PTNode* pt_node) {
  *
  * @param queue   container
  * @param helper  helper to insert
+ * @param width   picks kept in queue
  * @return false  please manage helper(eg: release it)
  * @return true   insert successfully or helper is nullptr
  */
-bool PatternTree::insert_death_que(DeathQue& queue, PickHelper* helper) {
+bool PatternTree::insert_death_que(DeathQue& queue, PickHelper* helper,
+                                   size_t width) {
   if (!helper) return true;
 
-  // bool repreat = false;
-  // DeathQue tmp;
-  // while (queue.size()) {
-  //   auto top = queue.top();
-  //   queue.pop();
-  //   tmp.push(top);
-
-  //   repreat |= is_pick_same(top, helper);
-  // }
-  // queue.swap(tmp);
-  // if (repreat) return false;
+  // keep one of same placements, the better one lends its order
+  helper->update_hash();
+  auto same = queue.find_same(helper);
+  if (same) {
+    if (CmpPickHelperDeath()(helper, same)) {
+      same->set_death(helper->get_death());
+      same->set_order(helper->get_order());
+      queue.reorder();
+    }
+    return false;
+  }
 
   // choose minimal death
-  if (queue.size() < max_combination) {
+  if (queue.size() < width) {
     queue.push(helper);
     return true;
   } else {
     auto worst = queue.top();
-    if (worst->get_death() > helper->get_death()) {
+    if (CmpPickHelperDeath()(helper, worst)) {
       queue.pop();
       delete worst;
       queue.push(helper);
@@ -1318,15 +1848,23 @@ bool PatternTree::insert_death_que(DeathQue& queue, PickHelper* helper) {
   return false;
 }
 
+/**
+ * @brief Place cells as helper. Helper only counts cells of every class, so
+ * concrete cells are assigned here, in pick order within every class.
+ */
 void VCG::set_cells_by_helper(PickHelper* helper) {
   _helper = helper;
 
-  for (auto item : _helper->get_items()) {
-    auto cell = _cm->get_cell(item->_cell_id);
-    assert(cell);
+  std::vector<int> used(_cm->get_classes_num(), 0);
+  for (auto id : _helper->get_vcg_ids()) {
+    assert(_helper->get_cell_id(id));
+    auto c = _helper->get_cell_class(id);
+    auto cell = _cm->get_class_cell(c, used[c]++);
+    _helper->set_cell(id, cell);
 
+    auto item = _helper->get_item(id);
     _tree->set_cell_status(cell, item);
-    do_pick_cell(item->_vcg_id, cell);
+    do_pick_cell(item._vcg_id, cell);
   }
 }
 
@@ -1378,35 +1916,35 @@ void PatternTree::second_pick_replace(PickHelper* first /*in*/,
                                       PickHelper* second /*out*/) {
   if (!first || !second) return;
 
-  _vcg->set_cells_by_helper(first);
-
-  // find repeat
+  // find repeat, cells of a class beyond its amount
+  std::vector<int> used(_classes, 0);
+  for (auto id : first->get_vcg_ids()) {
+    if (first->get_cell_id(id)) ++used[first->get_cell_class(id)];
+  }
   std::set<uint8_t> repeat_set;
-  for (auto item : second->get_items()) {
-    auto cell = _cm->get_cell(item->_cell_id);
-    ASSERT(cell, "Cell Manager miss cell_id = %d", item->_cell_id);
-
-    if (cell->get_vcg_id() != 0 /*cell has been placed*/) {
-      repeat_set.insert(item->_vcg_id);
-      item->_cell_id = 0;
+  for (auto id : second->get_vcg_ids()) {
+    if (second->get_cell_id(id) == 0) continue;
+    auto c = second->get_cell_class(id);
+    if (used[c] < _class_amount[c]) {
+      ++used[c];
+    } else {
+      repeat_set.insert(id);
+      second->set_cell(id, nullptr);
     }
   }
 
   for (auto vcg_id : repeat_set) {
-    auto item = second->get_item(vcg_id);
-
-    auto cellprio = _vcg->get_priority(item->_vcg_id);
-    auto cells = _cm->choose_cells(false, cellprio);
+    auto& cells = _cm->choose_class_cells(_vcg->get_cell_type(vcg_id));
     for (auto cell : cells) {
-      if (second->is_picked(cell->get_cell_id())) continue;
+      auto c = cell->get_class();
+      if (used[c] >= _class_amount[c]) continue;
 
-      item->_cell_id = cell->get_cell_id();
+      ++used[c];
+      second->set_cell(vcg_id, cell);
       break;
     }
   }
 
-  _vcg->undo_all_picks();
-
   // replace second helper
   replace(second);
 }
@@ -1416,80 +1954,62 @@ void PatternTree::replace(PickHelper* helper) {
 
   Point range;
   std::vector<uint8_t> placed;
-  for (auto item : helper->get_items()) {
-    auto cell = _cm->get_cell(item->_cell_id);
-    assert(cell);
+  for (auto id : helper->get_vcg_ids()) {
+    auto type = get_item_type(helper, id);
 
     int min_y = 0;
     int max_y = 0;
     // y : interposer bottom
-    if (is_interposer_bottom(item->_vcg_id)) {
-      get_cst_y(cell->get_cell_type(), range);
+    if (is_interposer_bottom(id)) {
+      get_cst_y(type, range);
       min_y = range._x;
       max_y = range._y;
     }
     // y : from
     std::set<uint8_t> froms_vcg_id_set;
-    get_from_vcg_ids(item->_vcg_id, froms_vcg_id_set);
+    get_from_vcg_ids(id, froms_vcg_id_set);
     for (auto from_id : froms_vcg_id_set) {
-      auto from_item = helper->get_item(from_id);
-      if (from_item == nullptr) continue;
+      if (!helper->has_item(from_id)) continue;
 
-      auto from_cell = _cm->get_cell(from_item->_cell_id);
-      assert(from_cell);
-
-      if (from_cell->get_rotation() != from_item->_rotation) {
-        from_cell->rotate();
-      }
+      auto from_box = get_item_box(helper, from_id);
+      auto from_cell_type = _vcg->get_cell_type(from_id);
+      get_cst_y(type, from_cell_type, range);
 
-      if (from_item) {
-        auto from_cell_type = _vcg->get_cell_type(from_id);
-        get_cst_y(cell->get_cell_type(), from_cell_type, range);
-
-        min_y = std::max(from_item->_c1_y + from_cell->get_height() + range._x,
-                         min_y);
-        max_y = max_y == 0
-                    ? from_item->_c1_y + from_cell->get_height() + range._y
-                    : std::min(
-                          from_item->_c1_y + from_cell->get_height() + range._y,
-                          max_y);
-      }
+      min_y = std::max(from_box._c3._y + range._x, min_y);
+      max_y = max_y == 0 ? from_box._c3._y + range._y
+                         : std::min(from_box._c3._y + range._y, max_y);
     }
 
-    item->_c1_y = min_y <= max_y ? min_y : max_y;
-    set_cell_status(cell, item);
+    helper->set_y(id, min_y <= max_y ? min_y : max_y);
+    auto box = get_item_box(helper, id);
 
     int min_x = 0;
     int max_x = 0;
     // x : interposer
-    if (is_interposer_left(item->_vcg_id)) {
-      get_cst_x(cell->get_cell_type(), range);
+    if (is_interposer_left(id)) {
+      get_cst_x(type, range);
       min_x = range._x;
       max_x = range._y;
     }
     // x : left
     for (auto vcg_id : placed) {
-      auto item_placed = helper->get_item(vcg_id);
-      assert(item_placed);
+      auto box_placed = get_item_box(helper, vcg_id);
 
-      auto cell_placed = _cm->get_cell(item_placed->_cell_id);
-      assert(cell_placed);
+      if (is_overlap(box._c1._y, box._c3._y, box_placed._c1._y,
+                     box_placed._c3._y, false)) {
+        get_cst_y(type, get_item_type(helper, vcg_id), range);
 
-      if (is_overlap_y(cell, cell_placed, false)) {
-        get_cst_y(cell->get_cell_type(), cell_placed->get_cell_type(), range);
-
-        min_x = std::max(cell_placed->get_c3()._x + range._x, min_x);
-        max_x = max_x == 0
-                    ? cell_placed->get_c3()._x + range._y
-                    : std::min(cell_placed->get_c3()._x + range._y, max_x);
+        min_x = std::max(box_placed._c3._x + range._x, min_x);
+        max_x = max_x == 0 ? box_placed._c3._x + range._y
+                           : std::min(box_placed._c3._x + range._y, max_x);
       }
     }
 
-    item->_c1_x = min_x <= max_x ? min_x : max_x;
+    helper->set_x(id, min_x <= max_x ? min_x : max_x);
 
-    placed.push_back(item->_vcg_id);
+    placed.push_back(id);
 
-  }  // end auto item
+  }  // end auto id
 }
 
 void PatternTree::get_from_vcg_ids(uint8_t vcg_id /*in*/,
@@ -1504,25 +2024,6 @@ void PatternTree::get_from_vcg_ids(uint8_t vcg_id /*in*/,
   }
 }
 
-bool PatternTree::is_pick_same(PickHelper* p1, PickHelper* p2) {
-  if (!p1 || !p2) return false;
-
-  auto items1 = p1->get_items();
-  auto items2 = p2->get_items();
-
-  auto item_num1 = items1.size();
-  auto item_num2 = items2.size();
-  auto num = std::min(item_num1, item_num2);
-
-  for (size_t i = 0; i < num; ++i) {
-    if (items1[i]->_cell_id != items2[i]->_cell_id) {
-      return false;
-    }
-  }
-
-  return true;
-}
-
 void PatternTree::second_pick_replace(PTNode* first /*in*/,
                                       PTNode* second /*in*/, DeathQue& queue) {
   if (!first || !second) return;
@@ -1534,8 +2035,8 @@ void PatternTree::second_pick_replace(PTNode* first /*in*/,
     queue.pop();
   }
 
-  auto fpick = first->get_picks();
-  auto spick = second->get_picks();
+  auto& fpick = first->get_picks();
+  auto& spick = second->get_picks();
   Rectangle box;
   for (auto f_it = fpick.rbegin(); f_it != fpick.rend(); ++f_it) {
     for (auto s_it = spick.rbegin(); s_it != spick.rend(); ++s_it) {
@@ -1552,596 +2053,225 @@ void PatternTree::second_pick_replace(PTNode* first /*in*/,
       // debug
       // debug_GDS(new_helper);
 
-      if (!insert_death_que(queue, new_helper)) {
+      if (!insert_death_que(queue, new_helper, _config._beam_width)) {
         delete new_helper;
       }
     }
   }
 }
 
-// wu wen_rui >>>>>>>
-
-void PatternTree::merge_wheel(PTNode *pt_node)
-{
-  assert(pt_node && pt_node->get_type() == kPTWheel);
-  auto children = pt_node->get_children();
-  ASSERT(children.size() == 5, "Topology error");
-  std::vector<uint8_t> orders;
-  get_topological_sort(pt_node->get_grid(), orders);
-  PTNode *child0;
-  PTNode *child1;
-  PTNode *child2;
-  PTNode *child3;
-  PTNode *child4;
-
-  for (auto child : children)
-  {
-    auto grid = child->get_grid();
-    if (grid[0][0] == orders[0])
-      child0 = child;
-    if (grid[0][0] == orders[1])
-      child1 = child;
-    if (grid[0][0] == orders[2])
-      child2 = child;
-    if (grid[0][0] == orders[3])
-      child3 = child;
-    if (grid[0][0] == orders[4])
-      child4 = child;
-  }
-
-  std::set<uint8_t> pick_vcg_id_set0;
-  std::set<uint8_t> pick_vcg_id_set1;
-  std::set<uint8_t> pick_vcg_id_set2;
-  std::set<uint8_t> pick_vcg_id_set3;
-  std::set<uint8_t> pick_vcg_id_set4;
-  std::vector<PickItem *> items0;
-  std::vector<PickItem *> items1;
-  std::vector<PickItem *> items2;
-  std::vector<PickItem *> items3;
-  std::vector<PickItem *> items4;
-
-  std::priority_queue<PickHelper *, std::vector<PickHelper *>,
-                      CmpPickHelperDeath> death_queue;
+/**
+ * @brief Merge children of pt_node one at a time, in the order of
+ * get_merge_steps(). After every step only the best picks (beam width) of
+ * the merged children are kept, so the cost grows with the number of
+ * children instead of the product of their picks.
+ */
+void PatternTree::merge_children(PTNode* pt_node) {
+  assert(pt_node && pt_node->get_children().size() > 1);
+  std::vector<MergeStep> steps;
+  get_merge_steps(pt_node, steps);
+  auto width = get_beam_width(pt_node);
+
+  // picks of first child, against interposer
+  std::vector<PickHelper*> partials;
+  std::vector<uint8_t> items;
   Rectangle box;
-  Point range;
-  auto grid0 = child0->get_grid();
-  if (child0->get_grid().size() > grid0[0].size())
-  {
-    for (auto pick0 : child0->get_picks())
-    {
-      PickHelper *pick_new0 = new PickHelper(pick0);
-      // interposer
-      child0->get_grid_lefts(pick_vcg_id_set0);
-      pick_new0->get_items(pick_vcg_id_set0, items0);
-      adjust_interposer_left(items0);
-
-      child0->get_grid_bottoms(pick_vcg_id_set0);
-      pick_new0->get_items(pick_vcg_id_set0, items0);
-      adjust_interposer_bottom(items0);
-
-      // update bottom box
-      get_helper_box(pick_new0, box);
-      pick_new0->set_box(box);
-
-      child0->get_grid_tops(pick_vcg_id_set0);
-      pick_new0->get_items(pick_vcg_id_set0, items0);
-
-      for (auto pick1 : child1->get_picks())
-      {
-        if (is_pick_repeat(pick0, pick1))
-          continue;
-
-        PickHelper *pick_new1 = new PickHelper(pick1);
-        // interposer
-        child1->get_grid_lefts(pick_vcg_id_set1);
-        pick_new1->get_items(pick_vcg_id_set1, items1);
-        adjust_interposer_left(items1);
-
-        // update top box
-        get_helper_box(pick_new1, box);
-        pick_new1->set_box(box);
-
-        child1->get_grid_bottoms(pick_vcg_id_set1);
-        pick_new1->get_items(pick_vcg_id_set1, items1);
-
-        
-        get_box_range_fit_bitems(items1, items0, pick_new0->get_box()._c3._y, range);
-        int y_move = range._x;
-        if (range._x > range._y)
-        {
-          y_move = range._y;
-
-          g_log << "[VRT merging violate] occur in pt_node = "
-                << std::to_string(pt_node->get_pt_id())
-                << "range.min_x = " << range._x << ", "
-                << "range.max_x = " << range._y << "\n";
+  auto first = steps[0]._child;
+  for (auto pick : first->get_picks()) {
+    auto partial = new PickHelper(pick);
+    partial->get_items(first->get_grid_lefts(), items);
+    adjust_interposer_left(partial, items);
+    partial->get_items(first->get_grid_bottoms(), items);
+    adjust_interposer_bottom(partial, items);
+    get_helper_box(partial, box);
+    partial->set_box(box);
+    partials.push_back(partial);
+  }
+
+  for (size_t k = 1; k < steps.size(); ++k) {
+    auto& step = steps[k];
+    auto& picks = step._child->get_picks();
+
+    // merge one partial pick with all picks of child
+    auto merge_partial = [&](size_t p_index, MergeWorker& worker,
+                             DeathQue& death_queue) {
+      Rectangle box;
+      auto partial = partials[p_index];
+      for (size_t c_index = 0; c_index < picks.size(); ++c_index) {
+        auto pick = picks[c_index];
+        ++worker._repeat_num;
+        if (is_pick_repeat(partial, pick)) continue;
+
+        auto pick_new = place_child(partial, step, pick);
+        PickHelper* new_helper = new PickHelper(partial, pick_new);
+        new_helper->set_order(p_index * picks.size() + c_index);
+        ++worker._pair_num;
+
+        get_helper_box(new_helper, box);
+        new_helper->set_box(box);
+        int cell_area = get_cells_area(new_helper);
+        new_helper->set_death(1.0 * (box.get_area() - cell_area) /
+                              box.get_area());
+
+        worker._best_death =
+            std::min(worker._best_death, new_helper->get_death());
+        if (!insert_death_que(death_queue, new_helper, width)) {
+          delete new_helper;
         }
 
-        for (auto r_item : pick_new1->get_items())
-        {
-          r_item->_c1_y += y_move;
-        }
-        // interposer
-        items1.clear();
-        pick_vcg_id_set1.clear();
-
-        child1->get_grid_lefts(pick_vcg_id_set1);
-        pick_new1->get_items(pick_vcg_id_set1, items1);
-        adjust_interposer_left(items1);
-        child1->get_grid_bottoms(pick_vcg_id_set1);
-        pick_new1->get_items(pick_vcg_id_set1, items1);
-        adjust_interposer_bottom(items1);
-
-        for (auto pick2 : child2->get_picks())
-        {
-          if (is_pick_repeat(pick0, pick1) || is_pick_repeat(pick1, pick2) || is_pick_repeat(pick0, pick2))
-            continue;
-
-          PickHelper *pick_new2 = new PickHelper(pick2);
-
-          // interposer
-          child2->get_grid_bottoms(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-          adjust_interposer_bottom(items2);
-
-          // update top box
-          get_helper_box(pick_new2, box);
-          pick_new2->set_box(box);
-
-          child2->get_grid_lefts(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-
-          get_box_range_fit_litems(items2, items1, pick_new0->get_box()._c3._x, range);
-          int x_move = range._x;
-          if (range._x > range._y)
-          {
-            x_move = range._y;
-
-            g_log << "[HRZ merging violate] occur in pt_node = "
-                  << std::to_string(pt_node->get_pt_id())
-                  << "range.min_x = " << range._x << ", "
-                  << "range.max_x = " << range._y << "\n";
-          }
-
-          for (auto r_item : pick_new2->get_items())
-          {
-            r_item->_c1_x += x_move;
-          }
-          // interposer
-          items2.clear();
-          pick_vcg_id_set2.clear();
-          child2->get_grid_lefts(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-          adjust_interposer_left(items2);
-
-          // update top box
-          get_helper_box(pick_new2, box);
-          pick_new2->set_box(box);
-
-          child2->get_grid_bottoms(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-
-          get_box_range_fit_bitems(items2, items0, pick_new0->get_box()._c3._y, range);
-          int y_move = range._x;
-          if (range._x > range._y)
-          {
-            y_move = range._y;
-
-            g_log << "[VRT merging violate] occur in pt_node = "
-                  << std::to_string(pt_node->get_pt_id())
-                  << "range.min_x = " << range._x << ", "
-                  << "range.max_x = " << range._y << "\n";
-          }
-
-          for (auto r_item : pick_new2->get_items())
-          {
-            r_item->_c1_y += y_move;
-          }
-
-          // interposer
-          items2.clear();
-          pick_vcg_id_set2.clear();
-
-          child2->get_grid_lefts(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-          adjust_interposer_left(items2);
-          child2->get_grid_bottoms(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-          adjust_interposer_bottom(items2);
-
-          for (auto pick3 : child3->get_picks())
-          {
-            if (is_pick_repeat(pick0, pick1) || is_pick_repeat(pick1, pick2) || is_pick_repeat(pick2, pick3) || is_pick_repeat(pick0, pick2) || is_pick_repeat(pick0, pick3) || is_pick_repeat(pick1, pick3))
-              continue;
-
-            PickHelper *pick_new3 = new PickHelper(pick3);
-
-            // interposer
-            child3->get_grid_bottoms(pick_vcg_id_set3);
-            pick_new3->get_items(pick_vcg_id_set3, items3);
-            adjust_interposer_bottom(items3);
-
-            // update top box
-            get_helper_box(pick_new3, box);
-            pick_new3->set_box(box);
-
-            child3->get_grid_lefts(pick_vcg_id_set3);
-            pick_new3->get_items(pick_vcg_id_set3, items3);
-
-            get_box_range_fit_litems(items3, items1, pick_new0->get_box()._c3._x, range);
-            int x_move = range._x;
-            if (range._x > range._y)
-            {
-              x_move = range._y;
-
-              g_log << "[HRZ merging violate] occur in pt_node = "
-                    << std::to_string(pt_node->get_pt_id())
-                    << "range.min_x = " << range._x << ", "
-                    << "range.max_x = " << range._y << "\n";
-            }
-
-            for (auto r_item : pick_new3->get_items())
-            {
-              r_item->_c1_x += x_move;
-            }
-
-            // interposer
-            items3.clear();
-            pick_vcg_id_set3.clear();
-
-            child3->get_grid_lefts(pick_vcg_id_set3);
-            pick_new3->get_items(pick_vcg_id_set3, items3);
-            adjust_interposer_left(items3);
-            child3->get_grid_bottoms(pick_vcg_id_set3);
-            pick_new3->get_items(pick_vcg_id_set3, items3);
-            adjust_interposer_bottom(items3);
-
-            for (auto pick4 : child4->get_picks())
-            {
-              if (is_pick_repeat(pick0, pick1) || is_pick_repeat(pick1, pick2) || is_pick_repeat(pick2, pick3) || is_pick_repeat(pick3, pick4) || is_pick_repeat(pick0, pick2) || is_pick_repeat(pick0, pick3) || is_pick_repeat(pick1, pick3) || is_pick_repeat(pick0, pick4) || is_pick_repeat(pick1, pick4) || is_pick_repeat(pick2, pick4))
-                continue;
-
-              PickHelper *pick_new4 = new PickHelper(pick4);
-
-              // interposer
-              child4->get_grid_lefts(pick_vcg_id_set4);
-              pick_new4->get_items(pick_vcg_id_set4, items4);
-              adjust_interposer_left(items4);
-
-              // update top box
-              get_helper_box(pick_new4, box);
-              pick_new4->set_box(box);
-
-              child4->get_grid_bottoms(pick_vcg_id_set4);
-              pick_new4->get_items(pick_vcg_id_set4, items4);
-
-              get_box_range_fit_bitems(items4, items3, pick_new0->get_box()._c3._y, range);
-              int y_move = range._x;
-              if (range._x > range._y)
-              {
-                y_move = range._y;
-
-                g_log << "[VRT merging violate] occur in pt_node = "
-                      << std::to_string(pt_node->get_pt_id())
-                      << "range.min_x = " << range._x << ", "
-                      << "range.max_x = " << range._y << "\n";
-              }
-
-              for (auto r_item : pick_new4->get_items())
-              {
-                r_item->_c1_y += y_move;
-              }
-              PickHelper *new_helper = new PickHelper(pick_new0, pick_new1, pick_new2, pick_new3, pick_new4);
-
-              get_helper_box(new_helper, box);
-              new_helper->set_box(box);
-              int cell_area = get_cells_area(new_helper);
-              new_helper->set_death(1.0 * (box.get_area() - cell_area) / box.get_area());
-
-              // debug
-              // debug_GDS(new_helper);
-
-              if (!insert_death_que(death_queue, new_helper))
-              {
-                delete new_helper;
-              }
-              delete pick_new4;
-            }
-            delete pick_new3;
-          }
-          delete pick_new2;
-        }
-        delete pick_new1;
+        delete pick_new;
       }
-      delete pick_new0;
+    };
+
+    DeathQue death_queue;
+    parallel_merge(partials.size(), merge_partial, width, death_queue);
+
+    for (auto partial : partials) {
+      delete partial;
     }
-  }
-  else
-  {
-    for (auto pick0 : child0->get_picks())
-    {
-      PickHelper *pick_new0 = new PickHelper(pick0);
-      // interposer
-      child0->get_grid_lefts(pick_vcg_id_set0);
-      pick_new0->get_items(pick_vcg_id_set0, items0);
-      adjust_interposer_left(items0);
-
-      child0->get_grid_bottoms(pick_vcg_id_set0);
-      pick_new0->get_items(pick_vcg_id_set0, items0);
-      adjust_interposer_bottom(items0);
-
-      // update bottom box
-      get_helper_box(pick_new0, box);
-      pick_new0->set_box(box);
-
-      child0->get_grid_tops(pick_vcg_id_set0);
-      pick_new0->get_items(pick_vcg_id_set0, items0);
-
-      for (auto pick1 : child1->get_picks())
-      {
-        if (is_pick_repeat(pick0, pick1))
-          continue;
-
-        PickHelper *pick_new1 = new PickHelper(pick1);
-        // interposer
-        child1->get_grid_bottoms(pick_vcg_id_set1);
-        pick_new1->get_items(pick_vcg_id_set1, items1);
-        adjust_interposer_bottom(items1);
-
-        // update top box
-        get_helper_box(pick_new1, box);
-        pick_new1->set_box(box);
-
-        child1->get_grid_lefts(pick_vcg_id_set1);
-        pick_new1->get_items(pick_vcg_id_set1, items1);
-
-        Point range;
-        get_box_range_fit_litems(items1, items0, pick_new0->get_box()._c3._x, range);
-        int x_move = range._x;
-        if (range._x > range._y)
-        {
-          x_move = range._y;
-
-          g_log << "[HRZ merging violate] occur in pt_node = "
-                << std::to_string(pt_node->get_pt_id())
-                << "range.min_x = " << range._x << ", "
-                << "range.max_x = " << range._y << "\n";
-        }
+    partials.clear();
 
-        for (auto r_item : pick_new1->get_items())
-        {
-          r_item->_c1_x += x_move;
-        }
-        // interposer
-        items1.clear();
-        pick_vcg_id_set1.clear();
-
-        child1->get_grid_lefts(pick_vcg_id_set1);
-        pick_new1->get_items(pick_vcg_id_set1, items1);
-        adjust_interposer_left(items1);
-        child1->get_grid_bottoms(pick_vcg_id_set1);
-        pick_new1->get_items(pick_vcg_id_set1, items1);
-        adjust_interposer_bottom(items1);
-
-        for (auto pick2 : child2->get_picks())
-        {
-          if (is_pick_repeat(pick0, pick1) || is_pick_repeat(pick1, pick2) || is_pick_repeat(pick0, pick2))
-            continue;
-          PickHelper *pick_new2 = new PickHelper(pick2);
-
-          // interposer
-          child2->get_grid_bottoms(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-          adjust_interposer_bottom(items2);
-
-          // update top box
-          get_helper_box(pick_new2, box);
-          pick_new2->set_box(box);
-
-          child2->get_grid_lefts(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-
-          Point range;
-          get_box_range_fit_litems(items2, items1, pick_new0->get_box()._c3._x, range);
-          int x_move = range._x;
-          if (range._x > range._y)
-          {
-            x_move = range._y;
-
-            g_log << "[HRZ merging violate] occur in pt_node = "
-                  << std::to_string(pt_node->get_pt_id())
-                  << "range.min_x = " << range._x << ", "
-                  << "range.max_x = " << range._y << "\n";
-          }
-
-          for (auto r_item : pick_new2->get_items())
-          {
-            r_item->_c1_x += x_move;
-          }
-          // interposer
-          items2.clear();
-          pick_vcg_id_set2.clear();
-          child2->get_grid_lefts(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-          adjust_interposer_left(items2);
-
-          // update top box
-          get_helper_box(pick_new2, box);
-          pick_new2->set_box(box);
-
-          child2->get_grid_bottoms(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-
-          get_box_range_fit_bitems(items2, items0, pick_new0->get_box()._c3._y, range);
-          int y_move = range._x;
-          if (range._x > range._y)
-          {
-            y_move = range._y;
-
-            g_log << "[VRT merging violate] occur in pt_node = "
-                  << std::to_string(pt_node->get_pt_id())
-                  << "range.min_x = " << range._x << ", "
-                  << "range.max_x = " << range._y << "\n";
-          }
-
-          for (auto r_item : pick_new2->get_items())
-          {
-            r_item->_c1_y += y_move;
-          }
-
-          // interposer
-          items2.clear();
-          pick_vcg_id_set2.clear();
-
-          child2->get_grid_lefts(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-          adjust_interposer_left(items2);
-          child2->get_grid_bottoms(pick_vcg_id_set2);
-          pick_new2->get_items(pick_vcg_id_set2, items2);
-          adjust_interposer_bottom(items2);
-
-          for (auto pick3 : child3->get_picks())
-          {
-            if (is_pick_repeat(pick0, pick1) || is_pick_repeat(pick1, pick2) || is_pick_repeat(pick2, pick3) || is_pick_repeat(pick0, pick2) || is_pick_repeat(pick0, pick3) || is_pick_repeat(pick1, pick3))
-              continue;
-
-            PickHelper *pick_new3 = new PickHelper(pick3);
-
-            // interposer
-            child3->get_grid_lefts(pick_vcg_id_set3);
-            pick_new3->get_items(pick_vcg_id_set3, items3);
-            adjust_interposer_left(items3);
-
-            // update top box
-            get_helper_box(pick_new3, box);
-            pick_new3->set_box(box);
-
-            child3->get_grid_bottoms(pick_vcg_id_set3);
-            pick_new3->get_items(pick_vcg_id_set3, items3);
-
-            Point range;
-            get_box_range_fit_bitems(items3, items1, pick_new0->get_box()._c3._y, range);
-            int y_move = range._x;
-            if (range._x > range._y)
-            {
-              y_move = range._y;
-
-              g_log << "[VRT merging violate] occur in pt_node = "
-                    << std::to_string(pt_node->get_pt_id())
-                    << "range.min_x = " << range._x << ", "
-                    << "range.max_x = " << range._y << "\n";
-            }
-
-            for (auto r_item : pick_new3->get_items())
-            {
-              r_item->_c1_y += y_move;
-            }
-
-            // interposer
-            items3.clear();
-            pick_vcg_id_set3.clear();
-
-            child3->get_grid_lefts(pick_vcg_id_set3);
-            pick_new3->get_items(pick_vcg_id_set3, items3);
-            adjust_interposer_left(items3);
-            child3->get_grid_bottoms(pick_vcg_id_set3);
-            pick_new3->get_items(pick_vcg_id_set3, items3);
-            adjust_interposer_bottom(items3);
-
-            for (auto pick4 : child4->get_picks())
-            {
-              if (is_pick_repeat(pick0, pick1) || is_pick_repeat(pick1, pick2) || is_pick_repeat(pick2, pick3) || is_pick_repeat(pick3, pick4) || is_pick_repeat(pick0, pick2) || is_pick_repeat(pick0, pick3) || is_pick_repeat(pick1, pick3) || is_pick_repeat(pick0, pick4) || is_pick_repeat(pick1, pick4) || is_pick_repeat(pick2, pick4))
-                continue;
-
-              PickHelper *pick_new4 = new PickHelper(pick4);
-
-              // interposer
-              child4->get_grid_bottoms(pick_vcg_id_set4);
-              pick_new4->get_items(pick_vcg_id_set4, items4);
-              adjust_interposer_bottom(items4);
-
-              // update top box
-              get_helper_box(pick_new4, box);
-              pick_new4->set_box(box);
-
-              child4->get_grid_lefts(pick_vcg_id_set4);
-              pick_new4->get_items(pick_vcg_id_set4, items4);
-
-              Point range;
-              get_box_range_fit_litems(items4, items3, pick_new0->get_box()._c3._x, range);
-              int x_move = range._x;
-              if (range._x > range._y)
-              {
-                x_move = range._y;
-
-                g_log << "[HRZ merging violate] occur in pt_node = "
-                      << std::to_string(pt_node->get_pt_id())
-                      << "range.min_x = " << range._x << ", "
-                      << "range.max_x = " << range._y << "\n";
-              }
-
-              for (auto r_item : pick_new4->get_items())
-              {
-                r_item->_c1_y += x_move;
-              }
-              PickHelper *new_helper = new PickHelper(pick_new0, pick_new1, pick_new2, pick_new3, pick_new4);
-
-              get_helper_box(new_helper, box);
-              new_helper->set_box(box);
-              int cell_area = get_cells_area(new_helper);
-              new_helper->set_death(1.0 * (box.get_area() - cell_area) / box.get_area());
-
-              // debug
-              // debug_GDS(new_helper);
-
-              if (!insert_death_que(death_queue, new_helper))
-              {
-                delete new_helper;
-              }
-              delete pick_new4;
-            }
-            delete pick_new3;
-          }
-          delete pick_new2;
-        }
-        delete pick_new1;
-      }
-      delete pick_new0;
+    _same_num += death_queue.get_same_num();
+    while (death_queue.size()) {
+      partials.push_back(death_queue.top());
+      death_queue.pop();
     }
   }
-}
 
- PickHelper::PickHelper(PickHelper *h1, PickHelper *h2, PickHelper *h3, PickHelper *h4, PickHelper *h5)
-{
-  ASSERT(h1 && h2 && h3 && h4 && h5, "Please enter valid data");
-
-  for (auto item : h1->get_items())
-  {
-    _items.push_back(new PickItem(*item));
-  }
-  for (auto item : h2->get_items())
-  {
-    _items.push_back(new PickItem(*item));
+  for (auto partial : partials) {
+    pt_node->insert_pick(partial);
   }
-  for (auto item : h3->get_items())
-  {
-    _items.push_back(new PickItem(*item));
-  }
-  for (auto item : h4->get_items())
-  {
-    _items.push_back(new PickItem(*item));
+}
+
+/**
+ * @brief Order children of pt_node, so that the children left of or below a
+ * child are merged before it. Ties are broken by the topological order of
+ * the grid, bottom first.
+ *
+ * @param steps  children in merging order, with their neighbours
+ */
+void PatternTree::get_merge_steps(PTNode* pt_node /*in*/,
+                                  std::vector<MergeStep>& steps /*out*/) {
+  auto& children = pt_node->get_children();
+  auto& grid = pt_node->get_grid();
+  steps.clear();
+
+  // child of every vcg_id
+  std::vector<int> owner(256, -1);
+  std::vector<VCGIdSet> ids(children.size());
+  for (size_t i = 0; i < children.size(); ++i) {
+    auto& view = children[i]->get_grid();
+    for (size_t col = 0; col < view.get_cols(); ++col) {
+      for (size_t row = 0; row < view.get_rows(); ++row) {
+        owner[view.at(col, row)] = i;
+        ids[i].set(view.at(col, row));
+      }
+    }
   }
-  for (auto item : h5->get_items())
-  {
-    _items.push_back(new PickItem(*item));
+
+  // neighbours owned by other children
+  std::vector<MergeStep> neighbours(children.size());
+  for (size_t col = 0; col < grid.get_cols(); ++col) {
+    for (size_t row = 0; row < grid.get_rows(); ++row) {
+      auto id = grid.at(col, row);
+      auto i = owner[id];
+      ASSERT(i >= 0, "vcg_id = %d without pt_node", id);
+      if (col > 0 && owner[grid.at(col - 1, row)] != i) {
+        neighbours[i]._lefts.set(grid.at(col - 1, row));
+      }
+      if (row + 1 < grid.get_rows() && owner[grid.at(col, row + 1)] != i) {
+        neighbours[i]._bottoms.set(grid.at(col, row + 1));
+      }
+    }
   }
-  for (auto item : _items)
-  {
-    _id_item_map[item->_vcg_id] = item;
+
+  std::vector<uint8_t> orders;
+  get_topological_sort(grid, orders);
+  std::vector<size_t> rank(children.size(), orders.size());
+  for (size_t r = 0; r < orders.size(); ++r) {
+    auto i = owner[orders[r]];
+    if (i >= 0) rank[i] = std::min(rank[i], r);
+  }
+
+  VCGIdSet merged;
+  std::vector<bool> done(children.size(), false);
+  while (steps.size() < children.size()) {
+    int next = -1;
+    for (size_t i = 0; i < children.size(); ++i) {
+      auto& before = neighbours[i];
+      if (done[i] || ((before._lefts | before._bottoms) & ~merged).any()) {
+        continue;
+      }
+      if (next < 0 || rank[i] < rank[next]) {
+        next = i;
+      }
+    }
+    ASSERT(next >= 0, "Cyclic children in pt_id = %d", pt_node->get_pt_id());
+
+    done[next] = true;
+    merged |= ids[next];
+    neighbours[next]._child = children[next];
+    steps.push_back(neighbours[next]);
   }
 }
 
-// <<<<<<<
+/**
+ * @brief Copy pick of step's child and place it right of its left
+ * neighbours and above its bottom neighbours in partial. Sides without
+ * neighbours are kept against interposer.
+ *
+ * @return PickHelper*  placed copy, please release it
+ */
+PickHelper* PatternTree::place_child(PickHelper* partial /*in*/,
+                                     const MergeStep& step /*in*/,
+                                     PickHelper* pick /*in*/) {
+  std::vector<uint8_t> items;
+  std::vector<uint8_t> lefts;
+  std::vector<uint8_t> bottoms;
+  Rectangle box;
+  Point range;
+
+  auto child = step._child;
+  auto pick_new = new PickHelper(pick);
+  pick_new->get_items(child->get_grid_lefts(), items);
+  adjust_interposer_left(pick_new, items);
+  pick_new->get_items(child->get_grid_bottoms(), items);
+  adjust_interposer_bottom(pick_new, items);
+
+  // start beyond all neighbours, fitting only moves further
+  int x_move = 0;
+  int y_move = 0;
+  partial->get_items(step._lefts, lefts);
+  partial->get_items(step._bottoms, bottoms);
+  for (auto id : lefts) {
+    x_move = std::max(x_move, get_item_box(partial, id)._c3._x);
+  }
+  for (auto id : bottoms) {
+    y_move = std::max(y_move, get_item_box(partial, id)._c3._y);
+  }
+  pick_new->move_x(x_move);
+  pick_new->move_y(y_move);
+
+  // spacing to overlapped neighbours, x twice as moving y changes overlaps
+  for (int pass = 0; pass < 2; ++pass) {
+    if (lefts.size()) {
+      pick_new->get_items(child->get_grid_lefts(), items);
+      get_box_range_fit_litems(pick_new, items, partial, lefts, x_move, range);
+      pick_new->move_x(range._x - x_move);
+      x_move = range._x;
+    }
+    if (bottoms.size() && pass == 0) {
+      pick_new->get_items(child->get_grid_bottoms(), items);
+      get_box_range_fit_bitems(pick_new, items, partial, bottoms, y_move,
+                               range);
+      pick_new->move_y(range._x - y_move);
+      y_move = range._x;
+    }
+  }
 
+  get_helper_box(pick_new, box);
+  pick_new->set_box(box);
+  return pick_new;
+}
 
 }  // namespace  EDA_CHALLENGE_Q4
\ No newline at end of file
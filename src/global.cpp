@@ -1,11 +1,13 @@
 #include "Debug.h"
 
+#include <new>
+
 namespace EDA_CHALLENGE_Q4 { 
 
 /**
  * @brief log file
  */
-std::fstream g_log; 
+thread_local std::fstream g_log;
 
 void log_init() {
 #ifndef G_LOG
@@ -24,4 +26,32 @@ return;
   g_log.close();
 }
 
-}
\ No newline at end of file
+/**
+ * @brief redirect g_log of the calling thread into another buffer, so that
+ * workers can collect their logs and commit them in order.
+ *
+ * @param buf     new buffer
+ * @return std::streambuf* buffer used before, please restore it later
+ */
+std::streambuf* log_redirect(std::streambuf* buf) {
+  return static_cast<std::ios&>(g_log).rdbuf(buf);
+}
+
+}
+
+#ifdef ALLOC_STAT
+namespace EDA_CHALLENGE_Q4 {
+thread_local size_t g_alloc_num = 0;
+}
+
+void* operator new(size_t size) {
+  ++EDA_CHALLENGE_Q4::g_alloc_num;
+  void* p = malloc(size);
+  if (p == nullptr) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+void operator delete(void* p, size_t) noexcept { free(p); }
+#endif